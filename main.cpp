@@ -1,59 +1,887 @@
+#include <winsock2.h>  // before windows.h, which would pull in winsock 1
 #include <windows.h>
 #include <math.h>
 #include <stdio.h>
 #include <string.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <time.h>
 #include <mmsystem.h>
 #include <wininet.h>
+#include <emmintrin.h>
 #include "libs/bass.h"
 
 #pragma comment(lib, "winmm.lib")
 #pragma comment(lib, "wininet.lib")
+#pragma comment(lib, "ws2_32.lib")
 
 #define ID_ABOUT 1001
 #define ID_EXIT 1002
 #define ID_TOGGLE_CONSOLE 1003
+#define ID_RUN_BENCHMARKS 1004
+#define ID_MEASURE_TTFA 1005
+#define ID_TIMESHIFT_PAUSE 1006
+#define ID_TIMESHIFT_REWIND 1007
+#define ID_TIMESHIFT_LIVE 1008
+#define ID_PROBE_STATIONS 1009
+#define ID_TELEMETRY_VIEW 1010
+#define ID_TELEMETRY_EXPORT 1011
+#define ID_TRACE_ENABLE 1012
+#define ID_TRACE_EXPORT 1013
+
+// Posted by the connect worker: wParam = request generation, lParam = stream
+#define WM_STATION_READY (WM_APP + 1)
+
+// Posted from BASS sync callbacks: wParam = STREAM_EVENT_*, lParam = stream
+#define WM_STREAM_EVENT (WM_APP + 2)
+
+// Posted by the measurement run: lParam = station to tune, or NULL to stop
+#define WM_TTFA_TUNE (WM_APP + 3)
 
 // Radio control IDs
 #define ID_TUNING_DIAL 2001
 #define ID_VOLUME_KNOB 2002
 #define ID_POWER_BUTTON 2003
 
-// Radio station data
+// Longest now-playing title kept per station, including the terminator
+#define ICY_TITLE_SIZE 128
+
+// Radio station data; the strings live in the directory's string pool
+// (or are literals for the built-in stations)
 typedef struct {
 	float frequency;
-	char name[64];
-	char description[128];
-	char streamUrl[256];
+	const char* name;
+	const char* description;
+	const char* streamUrl;
+	float power;  // relative transmitter power (0.0 to 1.0)
 } RadioStation;
 
-RadioStation g_stations[] = {
-	{10.230f, "SomaFM Groove", "Downtempo and chillout", "http://ice1.somafm.com/groovesalad-128-mp3"},
-	{11.470f, "WBGO Jazz88", "Jazz from Newark", "http://wbgo.streamguys.net/wbgo128"},
-	{12.650f, "Radio Paradise", "Eclectic music mix", "http://stream.radioparadise.com/mp3-128"},
-	{13.890f, "Classical Music", "Classical radio", "http://stream.wqxr.org/wqxr"},
-	{15.120f, "Jazz Radio", "Smooth jazz", "http://jazz-wr04.ice.infomaniak.ch/jazz-wr04-128.mp3"},
-	{16.350f, "FIP", "Eclectic French radio", "http://direct.fipradio.fr/live/fip-midfi.mp3"},
-	{18.810f, "TSF Jazz", "French jazz radio", "http://tsfjazz.ice.infomaniak.ch/tsfjazz-high.mp3"},
-	{20.040f, "Dublab", "Electronic and experimental", "http://dublab.out.airtime.pro:8000/dublab_a"},
-	{21.270f, "BBC World Service", "Global news and culture", "http://stream.live.vc.bbcmedia.co.uk/bbc_world_service"},
-	{23.730f, "WFMU", "Freeform experimental radio", "http://stream0.wfmu.org/freeform-128k"},
-	{24.960f, "ChillHop Music", "Lo-fi hip hop", "http://ice1.somafm.com/fluid"},
-	{27.420f, "Worldwide FM", "Global music discovery", "http://worldwidefm.out.airtime.pro:8000/worldwidefm_a"},
+// Used when there is no stations.txt next to the executable
+const RadioStation g_builtinStations[] = {
+	{10.230f, "SomaFM Groove", "Downtempo and chillout",
+	 "http://ice1.somafm.com/groovesalad-128-mp3", 0.90f},
+	{11.470f, "WBGO Jazz88", "Jazz from Newark",
+	 "http://wbgo.streamguys.net/wbgo128", 0.85f},
+	{12.650f, "Radio Paradise", "Eclectic music mix",
+	 "http://stream.radioparadise.com/mp3-128", 0.95f},
+	{13.890f, "Classical Music", "Classical radio",
+	 "http://stream.wqxr.org/wqxr", 0.90f},
+	{15.120f, "Jazz Radio", "Smooth jazz",
+	 "http://jazz-wr04.ice.infomaniak.ch/jazz-wr04-128.mp3", 0.80f},
+	{16.350f, "FIP", "Eclectic French radio",
+	 "http://direct.fipradio.fr/live/fip-midfi.mp3", 1.00f},
+	{18.810f, "TSF Jazz", "French jazz radio",
+	 "http://tsfjazz.ice.infomaniak.ch/tsfjazz-high.mp3", 0.85f},
+	{20.040f, "Dublab", "Electronic and experimental",
+	 "http://dublab.out.airtime.pro:8000/dublab_a", 0.80f},
+	{21.270f, "BBC World Service", "Global news and culture",
+	 "http://stream.live.vc.bbcmedia.co.uk/bbc_world_service", 1.00f},
+	{23.730f, "WFMU", "Freeform experimental radio",
+	 "http://stream0.wfmu.org/freeform-128k", 0.85f},
+	{24.960f, "ChillHop Music", "Lo-fi hip hop",
+	 "http://ice1.somafm.com/fluid", 0.80f},
+	{27.420f, "Worldwide FM", "Global music discovery",
+	 "http://worldwidefm.out.airtime.pro:8000/worldwidefm_a", 0.90f},
 };
 
-#define NUM_STATIONS (sizeof(g_stations) / sizeof(RadioStation))
-#define SAMPLE_RATE 44100
-#define BITS_PER_SAMPLE 16
-#define CHANNELS 1
+#define NUM_BUILTIN_STATIONS (sizeof(g_builtinStations) / sizeof(RadioStation))
+
+// Station directory: loaded once at startup and sorted by frequency.
+// Lookups only touch the hot key array (one float per station) and a
+// bucket table over quantized frequency; the station records and their
+// strings are read once a station has been found
+#define STATION_DIRECTORY_MAX 8192
+#define STATION_STRINGS_SIZE (1024 * 1024)
+#define STATION_NAME_MAX 64          // longer names and descriptions are cut
+#define STATION_DESCRIPTION_MAX 128
+#define STATION_FILE "stations.txt"
+#define HEALTH_CACHE_FILE "stations.cache"
+#define CONN_CACHE_FILE "connections.cache"
+#define TELEMETRY_FILE "telemetry.csv"
+#define LOG_FILE "shortwave.log"
+#define LOG_FILE_OLD "shortwave.log.1"
+#define TRACE_FILE "trace.json"
+
+typedef struct {
+	const float* keys;  // sorted ascending
+	int count;
+	const int* buckets; // first key in each bucket; bucketCount + 1 entries
+	int bucketCount;
+	float low;          // frequency at the start of bucket 0
+	float scale;        // buckets per MHz
+} StationIndex;
+
+RadioStation g_stations[STATION_DIRECTORY_MAX];
+int g_stationCount = 0;
+float g_stationKeys[STATION_DIRECTORY_MAX];
+int g_stationBuckets[STATION_DIRECTORY_MAX + 1];
+StationIndex g_stationIndex = {};
+char g_stationStrings[STATION_STRINGS_SIZE];
+int g_stationStringsUsed = 0;
+
+#define SAMPLE_RATE 44100  // requested at init; the device may differ
 #define BUFFER_SIZE 4410  // 0.1 seconds of audio
 #define NUM_BUFFERS 4
 
+// Propagation model: receiver filter skirt (third-order Butterworth
+// magnitude, tapered to meet zero at the capture range) read from a
+// table, scaled by transmitter power and slow ionospheric fading
+#define SKIRT_BANDWIDTH 0.15f  // MHz at -3 dB
+#define SKIRT_ORDER 3
+#define SKIRT_TABLE_RANGE 0.5f  // MHz; FindNearestStation's capture range
+#define SKIRT_TABLE_SIZE 512
+#define SKIRT_TABLE_TOLERANCE 0.0001f  // table vs analytic, benchmark check
+#define FADING_DEPTH 0.3f
+
+// Functions compiled for SSE2 are only called after a runtime CPU check
+#if defined(__GNUC__)
+#define SSE2_TARGET __attribute__((target("sse2")))
+#else
+#define SSE2_TARGET
+#endif
+
+// Block noise generator: four independent xorshift32 lanes stepped together
+// so the scalar and SSE2 paths produce the same sequence
+typedef struct {
+	DWORD lane[4];
+	DWORD spare[4];  // lane outputs stepped but not yet emitted
+	int spareCount;
+} NoiseGenerator;
+
+typedef void (*NoiseFillFunc)(NoiseGenerator* gen, float* out, DWORD count,
+							  float gain);
+
+// Maps a signed 32-bit lane value to -1.0 .. 1.0
+#define NOISE_SCALE (1.0f / 2147483648.0f)
+
+#define STATIC_NOISE_SEED 0x5EED5EED
+
+// Sine table for the LFOs (one extra entry so interpolation never wraps)
+#define SINE_TABLE_BITS 10
+#define SINE_TABLE_SIZE (1 << SINE_TABLE_BITS)
+
+// LFO gain is held for this many samples, aligned to the sample clock
+#define LFO_BLOCK_SIZE 32
+#define MAX_LFOS 4
+
+// Phase-accumulator LFO; a full cycle is 2^32 phase units
+typedef struct {
+	DWORD phase;
+	DWORD increment;
+	float depth;
+} Lfo;
+
+typedef struct {
+	Lfo lfo[MAX_LFOS];
+	int count;
+	DWORD position;  // samples rendered, modulo 2^32
+	float blockGain;
+} LfoBank;
+
+// Atmosphere parameters are updated once per block, aligned to the
+// sample clock; the per-sample work is fixed regardless of the dial
+#define ATMOSPHERE_BLOCK_SIZE 256
+#define ATMOSPHERE_BUDGET_US 300.0  // per block on the reference XP box
+#define MAX_WHISTLES 2
+
+// Heterodyne whistles: beat pitch rises with distance from a carrier
+#define WHISTLE_HZ_PER_MHZ 10000.0f
+#define WHISTLE_MAX_OFFSET 0.35f  // MHz
+#define WHISTLE_LEVEL 0.2f
+
+// Lightning crackle timing
+#define CRACKLE_MEAN_INTERVAL 0.6f  // seconds
+#define CRACKLE_MIN_INTERVAL 0.005f
+
+typedef struct {
+	DWORD phase;
+	DWORD increment;
+	int incrementStep;  // per-sample glide towards the block target
+	float level;
+	float levelStep;
+} Whistle;
+
+typedef struct {
+	float sampleRate;
+	DWORD position;  // samples rendered, modulo 2^32
+
+	// White noise feeding the pink/brown filters and the crackle
+	NoiseGenerator white;
+	NoiseGenerator events;  // scalar draws for crackle timing
+	float pink[3];
+	float brown;
+
+	// Receiver band-limiting and the low/high split for selective fading
+	float bandState;
+	float bandCoef;
+	float splitState;
+	float splitCoef;
+
+	// Slow, independent fading of the low and high halves of the band
+	LfoBank fadeLow;
+	LfoBank fadeHigh;
+	float lowGain, lowGainStep;
+	float highGain, highGainStep;
+
+	// Subtle overall swell of the static
+	LfoBank swell;
+
+	// Impulsive crackle: a decaying noise burst per strike
+	DWORD crackleCountdown;
+	float crackleLevel;
+	float crackleDecay;
+
+	// Carriers the whistles beat against: the station directory, except
+	// in the benchmark
+	const StationIndex* carriers;
+	Whistle whistle[MAX_WHISTLES];
+} AtmosphereState;
+
+// Parameter smoothing: the UI posts targets, the audio thread glides
+// the value towards them per sample over a fixed time, whatever the
+// buffer size or how often the target changes
+#define SMOOTH_LINEAR 0    // straight ramp that lands in exactly the ramp time
+#define SMOOTH_ONE_POLE 1  // exponential; the ramp time is the time constant
+#define MIXER_SMOOTH_MODE SMOOTH_LINEAR
+#define MIXER_SMOOTH_TIME 0.05f  // seconds
+
+typedef struct {
+	int mode;
+	float value;
+	float target;       // target the current glide is heading for
+	DWORD rampSamples;  // linear: length of a full ramp
+	DWORD remaining;    // linear: samples left in the current ramp
+	float step;         // linear: per-sample increment
+	float coef;         // one-pole: fraction of the gap closed per sample
+} SmoothedParam;
+
+// The mixer is the only playing channel: it pulls decoded station audio,
+// renders the atmosphere and outputs one stereo float stream
+#define MIXER_CHANNELS 2
+#define MIXER_PULL_FRAMES 512
+#define MIXER_MAX_SOURCE_CHANNELS 8
+
+// Compressed bytes buffered before (re)starting, until the buffer
+// controller decides, and kept back while playing so a pull never blocks
+#define MIXER_MIN_BUFFERED 4096
+#define MIXER_RUN_FLOOR 1024
+#define MIXER_STALL_MS 1000  // an underrun this long counts as a stall
+
+typedef struct {
+	// Decoding channel of the tuned station (0 when none)
+	HSTREAM station;
+	DWORD stationChans;
+
+	// Linear resampler from the station's rate to the mixer rate
+	double step;   // station frames per output frame
+	double phase;  // position between previous and current frame
+	float previous[MIXER_CHANNELS];
+	float current[MIXER_CHANNELS];
+	float pull[MIXER_PULL_FRAMES * MIXER_MAX_SOURCE_CHANNELS];
+	DWORD pullFrames;
+	DWORD pullIndex;
+
+	int staticEnabled;
+
+	// Time the first station frames were pulled after an attach; the
+	// flag is raised by the mixer thread and cleared by the UI thread
+	int awaitingAudio;
+	LARGE_INTEGER firstAudioAt;
+	volatile LONG firstAudio;
+
+	// Compressed bytes that must be buffered before pulling, posted by the
+	// buffer controller; running dry after the first audio is an underrun
+	volatile DWORD minBuffered;
+	volatile int starved;
+	volatile DWORD starvedSince;  // GetTickCount() when it last ran dry
+	volatile LONG underruns;
+
+	// The same for the attached station only; restart at each attach
+	volatile LONG stationUnderruns;
+	volatile LONG stationStalls;
+	int stallCounted;  // the current underrun is already a stall
+
+	// Targets are written by the UI thread; the mixer glides towards them
+	volatile float stationTarget;
+	volatile float staticTarget;
+	SmoothedParam stationGain;
+	SmoothedParam staticGain;
+} MixerState;
+
+// IF filter: a cascade of biquads on the station audio whose passband
+// narrows and shifts up as the dial moves off the carrier
+#define IF_MAX_SECTIONS 4
+#define IF_SECTIONS 3         // low-pass, high-pass, low-pass
+#define IF_BLOCK_SIZE 64      // coefficients glide to new targets per block
+#define IF_LOWPASS_HZ 7000.0f
+#define IF_LOWPASS_SQUEEZE 16.0f  // cutoff divisor per MHz of detune
+#define IF_HIGHPASS_HZ 150.0f
+#define IF_HIGHPASS_SHIFT 2400.0f  // Hz per MHz of detune
+#define IF_MIN_LOWPASS_HZ 600.0f
+
+// Transposed direct form II; a1 and a2 are stored negated
+typedef struct {
+	float b0, b1, b2;
+	float a1, a2;
+} BiquadCoefs;
+
+typedef struct IfFilter IfFilter;
+typedef void (*IfFilterFunc)(IfFilter* filter, float* samples, DWORD frames);
+
+struct IfFilter {
+	IfFilterFunc run;  // scalar or SSE2 kernel
+	int sections;
+	float sampleRate;
+	DWORD position;  // frames filtered, modulo 2^32
+	int primed;      // coefficients hold a target to glide from
+	BiquadCoefs coef[IF_MAX_SECTIONS];
+	BiquadCoefs step[IF_MAX_SECTIONS];  // per-frame glide
+	float z1[IF_MAX_SECTIONS][MIXER_CHANNELS];
+	float z2[IF_MAX_SECTIONS][MIXER_CHANNELS];
+};
+
+// Output levels published by the mixer thread. Single writer: the
+// sequence is odd while an update is in progress, and readers retry
+// until they see the same even value before and after copying
+typedef struct {
+	volatile LONG sequence;
+	volatile float peak[MIXER_CHANNELS];  // true peak with slow release
+	volatile float rms[MIXER_CHANNELS];   // VU-style 300 ms average
+} LevelSnapshot;
+
+// Meter ballistics, carried from block to block. Only the mixer thread
+// touches them, and StartMixer clears them before it runs
+typedef struct {
+	float peakHold[MIXER_CHANNELS];
+	float meanSquare[MIXER_CHANNELS];
+} MeterState;
+
+#define METER_RMS_TIME 0.3f      // seconds
+#define METER_PEAK_RELEASE 1.5f  // seconds to fall by 20 dB
+
+// Band scope panel: live spectrum over a scrolling waterfall, drawn
+// straight into a DIB section and blitted in one call
+#define SCOPE_X 420
+#define SCOPE_Y 254
+#define SCOPE_WIDTH 120
+#define SCOPE_SPECTRUM_HEIGHT 22
+#define SCOPE_WATERFALL_HEIGHT 34
+#define SCOPE_HEIGHT (SCOPE_SPECTRUM_HEIGHT + SCOPE_WATERFALL_HEIGHT)
+#define SCOPE_FFT_BINS 256      // BASS_DATA_FFT512 returns 256 magnitudes
+#define SCOPE_MAX_BIN 128       // show the lower half (0 - 11 kHz at 44.1 kHz)
+#define SCOPE_FLOOR_DB -90.0f
+#define SCOPE_BUDGET_US 1000.0  // per frame on the reference XP box
+
+// Station strip under the dial, border included: its painting and every
+// invalidation of it use this one rectangle
+const RECT g_stationStrip = {50, 320, 551, 361};
+
+typedef struct {
+	HBITMAP bitmap;
+	HDC dc;
+	DWORD* pixels;  // top-down 32-bit rows
+	DWORD palette[256];
+	float fft[SCOPE_FFT_BINS];
+	BYTE columnLevel[SCOPE_WIDTH];
+} BandScope;
+
+// GDI resources: every pen, brush and font the Draw functions use is
+// built once at startup and looked up by style, so painting only selects
+// objects and the handle count stays flat. A style missing from the
+// startup list is created on first use and kept
+#define GDI_CACHE_SIZE 128      // pens and brushes; a power of two
+#define GDI_FONTS 8
+#define GDI_TRANSIENT_MAX 256   // benchmark: objects made for one frame
+#define GDI_FRAME_WIDTH 600     // benchmark frame, the window's size
+#define GDI_FRAME_HEIGHT 450
+
+typedef struct {
+	DWORD key;  // kind and width in the top byte, colour below; 0 = empty
+	HGDIOBJ object;
+} GdiEntry;
+
+typedef struct {
+	int height;
+	DWORD pitchAndFamily;
+	const char* face;
+	HFONT font;
+} GdiFont;
+
+typedef struct {
+	GdiEntry entries[GDI_CACHE_SIZE];
+	int count;
+	GdiFont fonts[GDI_FONTS];
+	int fontCount;
+	int misses;  // styles created after startup
+	// Benchmark only: hand out a fresh object per request, as painting
+	// did before the cache, and free them after the frame
+	int uncached;
+	HGDIOBJ transient[GDI_TRANSIENT_MAX];
+	int transientCount;
+} GdiCache;
+
+// Tuner: the dial must rest on a station for a dwell time before it
+// connects, and a locked station survives weak signal for a grace period,
+// with separate lock and drop thresholds so fading can't flap the link
+#define TUNER_IDLE 0      // no station
+#define TUNER_SETTLING 1  // candidate above the lock threshold, dwell running
+#define TUNER_LOCKED 2    // connected or connecting
+#define TUNER_LOSING 3    // locked station below the drop threshold, in grace
+
+#define TUNER_LOCK_THRESHOLD 50  // signal strength (0 - 100)
+#define TUNER_DROP_THRESHOLD 25
+#define TUNER_DWELL_MS 300
+#define TUNER_GRACE_MS 1500
+
+#define TUNER_ACTION_NONE 0
+#define TUNER_ACTION_CONNECT 1     // connect to locked
+#define TUNER_ACTION_DISCONNECT 2
+
+typedef struct {
+	int state;
+	RadioStation* locked;
+	RadioStation* candidate;
+	DWORD candidateSince;
+	DWORD lostSince;
+	RadioStation* failed;  // not retried until the dial leaves it
+
+	// Counted when the actions are issued
+	DWORD connects;
+	DWORD disconnects;
+} Tuner;
+
+// Station connects run on a worker thread so the message loop never
+// waits on DNS, TCP or prebuffering. Only the newest request matters:
+// every request or cancel bumps the generation, and a stream opened
+// for an older generation is freed instead of being played
+#define WORKER_EXIT_SLACK_MS 1000  // on top of the BASS net timeouts
+
+typedef struct {
+	HANDLE thread;
+	HANDLE wake;  // auto-reset; set when a request is queued or on quit
+	HWND notify;  // receives WM_STATION_READY
+	CRITICAL_SECTION lock;  // guards pending and generation
+	RadioStation* pending;
+	LONG generation;
+	volatile LONG quit;
+} ConnectWorker;
+
+// Warm standby: stations near the dial, ahead in the drag direction
+// first, are opened in the background as decoding channels nobody reads,
+// so the tuner can take one over without waiting for the connect
+#define PREFETCH_MAX_STREAMS 2          // bandwidth cap: warm connections
+#define PREFETCH_MAX_BYTES (512 * 1024) // memory cap: data held by the pool
+#define PREFETCH_RANGE 4.0f             // MHz; stations further away stay cold
+#define PREFETCH_POLL_MS 1000           // how often the worker checks the caps
+#define PREFETCH_RETRY_BASE_MS 2000     // first wait after a failed open
+#define PREFETCH_RETRY_MAX_MS 120000    // doubling stops here
+
+typedef struct {
+	RadioStation* station;
+	HSTREAM stream;
+} WarmStream;
+
+// A station that failed to open waits before the next try, doubling
+// each time, so a dead server near the dial isn't hit on every poll.
+// Indexed like g_stations; prefetch worker only
+typedef struct {
+	DWORD retryAt;
+	int failures;
+} PrefetchRetry;
+
+typedef struct {
+	HANDLE thread;
+	HANDLE wake;  // auto-reset; set when the wanted set changes or on quit
+	CRITICAL_SECTION lock;  // guards wanted and pool
+	RadioStation* wanted[PREFETCH_MAX_STREAMS];  // most wanted first
+	WarmStream pool[PREFETCH_MAX_STREAMS];
+	volatile LONG quit;
+
+	// UI thread only
+	float lastFrequency;
+	int direction;  // -1, 0 or +1 from the last dial movement
+	DWORD hits;
+	DWORD misses;
+} PrefetchPool;
+
+// Timeshift: the station audio is captured continuously as 16-bit stereo
+// into a ring in a memory-mapped temp file. The mixer thread only fills
+// small staging blocks in RAM; a writer thread copies full blocks into
+// the mapping in order, and reads the blocks ahead of the play cursor
+// back into RAM, so a page fault on the file never stalls audio
+#define TIMESHIFT_SECONDS 600
+#define TIMESHIFT_REWIND_SECONDS 10
+#define TIMESHIFT_BLOCK_FRAMES 8192
+#define TIMESHIFT_BLOCK_SAMPLES (TIMESHIFT_BLOCK_FRAMES * MIXER_CHANNELS)
+#define TIMESHIFT_STAGING_BLOCKS 8
+#define TIMESHIFT_REPLAY_BLOCKS 4  // read ahead of the play cursor
+#define TIMESHIFT_EXIT_MS 2000     // a writer stuck on the disk is left behind
+
+typedef struct {
+	HANDLE file;
+	HANDLE mapping;
+	short* ring;       // mapped view, interleaved stereo
+	DWORD ringFrames;  // whole number of blocks
+
+	// Staging: filled by the mixer thread, drained by the writer. Block n
+	// of the capture always lands at ring frame n * TIMESHIFT_BLOCK_FRAMES
+	// modulo the ring, so a dropped block leaves a gap instead of a shift
+	short staging[TIMESHIFT_STAGING_BLOCKS][TIMESHIFT_BLOCK_SAMPLES];
+	DWORD stagingBlock[TIMESHIFT_STAGING_BLOCKS];  // capture block number
+	DWORD stagingFill;             // frames in the block being filled
+	int skipping;                  // current block is being dropped
+	volatile LONG stagedBlocks;    // blocks handed to the writer
+	volatile LONG drainedBlocks;   // blocks copied into the ring
+	volatile LONG committedBlocks; // capture blocks readable from the ring
+	ULONGLONG capturedFrames;      // frames captured, staged or not
+	DWORD dropped;                 // blocks lost because the writer fell behind
+
+	// Replay staging: loaded by the writer from the wanted block on, block
+	// n in slot n % TIMESHIFT_REPLAY_BLOCKS. The mixer reads a slot only
+	// while it holds the block it needs, else it falls back to the mapping
+	short replay[TIMESHIFT_REPLAY_BLOCKS][TIMESHIFT_BLOCK_SAMPLES];
+	volatile LONG replayBlock[TIMESHIFT_REPLAY_BLOCKS];  // -1 while loading
+	volatile LONG replayWanted;    // block under the play cursor, -1 when live
+	DWORD replayMisses;            // runs read from the mapping instead
+
+	HANDLE thread;
+	HANDLE wake;
+	volatile LONG quit;
+
+	// Playback, changed by the UI thread under BASS_ChannelLock
+	int paused;
+	int shifted;       // playing from the ring instead of live
+	ULONGLONG playFrame;  // next capture frame to play
+} Timeshift;
+
+// Health prober: a small batch of low-priority threads connects to every
+// station in turn and records how it answered. Results are cached on
+// disk by stream URL so the next start knows which stations are off air
+#define PROBE_THREADS 3
+#define HEALTH_SLOW_MS 3000            // first audio later than this is slow
+#define HEALTH_MAX_AGE (6 * 60 * 60)   // seconds before a result is re-probed
+#define HEALTH_DEAD_AGE (15 * 60)      // seconds a dead result blocks tuning
+#define HEALTH_CACHE_MAGIC 0x43485753  // "SWHC"
+#define HEALTH_CACHE_VERSION 1
+
+enum {
+	HEALTH_UNKNOWN,
+	HEALTH_OK,
+	HEALTH_SLOW,
+	HEALTH_DEAD
+};
+
+// Also the on-disk record, so kept compact (20 bytes)
+typedef struct {
+	DWORD urlHash;      // FNV-1a of the stream URL
+	DWORD checked;      // time() of the probe
+	DWORD ctype;        // BASS_CTYPE_* of the stream
+	WORD connectMs;     // until the server's response headers
+	WORD firstByteMs;   // until the first audio data
+	WORD bitrate;       // kbps
+	BYTE status;        // HEALTH_*
+	BYTE error;         // BASS error code when dead
+} StationHealth;
+
+typedef struct {
+	HANDLE threads[PROBE_THREADS];
+	volatile LONG next;    // next station index to claim
+	volatile LONG active;  // threads still probing
+	volatile LONG quit;
+	int force;             // re-probe fresh results too
+	volatile LONG probed;
+	CRITICAL_SECTION lock; // guards g_stationHealth against the UI's reads
+} HealthProber;
+
+typedef struct {
+	LARGE_INTEGER start;
+	float connectMs;
+	float firstByteMs;
+} ProbeTiming;
+
+// Connection cache: where each station URL really ends up after HTTP
+// redirects and .pls/.m3u playlists, resolved in the background by the
+// prober so tuning can open the final URL directly. An entry lives as
+// long as the weakest link in its chain allows
+#define CONN_CACHE_SIZE 256
+#define CONN_URL_SIZE 256
+#define CONN_MAX_HOPS 5
+#define CONN_TTL_PERMANENT (7 * 24 * 60 * 60)  // 301 and 308 redirects
+#define CONN_TTL_TEMPORARY (60 * 60)           // 302, 303 and 307
+#define CONN_TTL_PLAYLIST (24 * 60 * 60)
+#define CONN_CACHE_MAGIC 0x43435753  // "SWCC"
+#define CONN_CACHE_VERSION 1
+
+typedef struct {
+	DWORD urlHash;      // of the station URL; 0 = free slot
+	DWORD resolved;     // time() of the resolution
+	DWORD ttl;          // seconds
+	WORD hops;          // redirects and playlists skipped
+	WORD resolveMs;     // what the chain cost to walk
+	char finalUrl[CONN_URL_SIZE];
+	char address[16];   // IPv4 of the final host
+	char contentType[48];
+} ConnCacheEntry;
+
+typedef struct {
+	ConnCacheEntry entries[CONN_CACHE_SIZE];
+	CRITICAL_SECTION lock;
+	HINTERNET internet;
+	int dirty;
+} ConnCache;
+
+// Time to first audio: request to the first decoded station frames,
+// kept for the last tunes so the percentiles track recent conditions
+#define TTFA_HISTORY 64
+#define TTFA_TIMEOUT_MS 10000     // measurement run: give up on a station
+#define TTFA_PLAY_SECONDS 12      // measurement run: played for CPU and drops
+
+typedef struct {
+	float ms[TTFA_HISTORY];
+	int count;
+	int next;
+} LatencyHistory;
+
+// Stand-in ICY server for the measurement run: a listener on 127.0.0.1
+// serving silent 128 kbps MP3, where each path is a scripted profile, so
+// slow, throttled, dropping and tagged servers can be reproduced without
+// live stations. The stand-in stations borrow directory slots past
+// g_stationCount, so the side tables indexed like g_stations apply
+#define STANDIN_BITRATE 128        // kbps
+#define STANDIN_FRAME_BYTES 417    // one 128 kbps, 44.1 kHz MP3 frame
+#define STANDIN_BURST_SECONDS 2    // sent at once on connect, like Icecast
+#define STANDIN_META_INTERVAL 8192 // icy-metaint
+#define STANDIN_META_BLOCKS 4      // intervals per title change
+#define STANDIN_CHUNK 1024
+#define STANDIN_TICK_MS 20
+#define STANDIN_IO_TIMEOUT_MS 5000
+#define STANDIN_URL_SIZE 64
+
+typedef struct {
+	const char* path;   // also the stand-in station's name
+	int status;         // HTTP status; 200 streams, 0 hangs up unanswered
+	const char* location;  // redirect target path for a 3xx
+	DWORD latencyMs;    // before the response headers
+	DWORD percentRate;  // of real time after the burst; 100 keeps up
+	DWORD dropAfterMs;  // connection closed after this long; 0 never
+	DWORD stallAfterMs; // sending stops after this long, connection kept open
+	int metadata;       // icy-metaint with a changing StreamTitle
+	int health;         // HEALTH_* the prober should report
+} StandinProfile;
+
+const StandinProfile g_standinProfiles[] = {
+	{"/clean", 200, NULL, 0, 100, 0, 0, 0, HEALTH_OK},
+	{"/latency", 200, NULL, 800, 100, 0, 0, 0, HEALTH_OK},
+	{"/throttle", 200, NULL, 0, 80, 0, 0, 0, HEALTH_OK},
+	{"/drop", 200, NULL, 0, 100, 4000, 0, 0, HEALTH_OK},
+	{"/stall", 200, NULL, 0, 100, 0, 4000, 0, HEALTH_OK},
+	{"/meta", 200, NULL, 0, 100, 0, 0, 1, HEALTH_OK},
+	{"/slow", 200, NULL, HEALTH_SLOW_MS + 500, 100, 0, 0, 0, HEALTH_SLOW},
+	{"/missing", 404, NULL, 0, 100, 0, 0, 0, HEALTH_DEAD},
+	{"/hangup", 0, NULL, 0, 100, 0, 0, 0, HEALTH_DEAD},
+	{"/redirect", 302, "/hop", 150, 100, 0, 0, 0, HEALTH_OK},
+	{"/hop", 302, "/clean", 150, 100, 0, 0, 0, HEALTH_OK},
+};
+
+#define NUM_STANDIN_PROFILES \
+	(sizeof(g_standinProfiles) / sizeof(StandinProfile))
+
+typedef struct {
+	SOCKET listener;
+	WORD port;
+	HANDLE thread;
+	volatile LONG quit;
+	volatile LONG active;       // connections being served
+	volatile LONG connections;  // accepted since the start
+	char urls[NUM_STANDIN_PROFILES][STANDIN_URL_SIZE];
+} StandinServer;
+
+// Logging: Log() copies its format pointer and arguments into a fixed
+// record in a bounded lock-free ring and returns; a low-priority drain
+// thread formats the records to the console and a rotating log file.
+// Any thread may log, BASS callbacks included. When the ring is full
+// the record is dropped and counted rather than waited for
+#define LOG_RING_SIZE 2048  // records; a power of two
+#define LOG_MAX_ARGS 12
+#define LOG_TEXT_SIZE (CONN_URL_SIZE + ICY_TITLE_SIZE)  // %s args, packed
+#define LOG_DRAIN_MS 50
+#define LOG_FILE_MAX (1024 * 1024)
+
+typedef union {
+	LONGLONG i;
+	double d;
+	const void* p;
+	int text;  // offset of a %s argument in the record's text
+} LogArg;
+
+typedef struct {
+	volatile LONG sequence;  // ready when one past the slot's claim
+	DWORD time;
+	DWORD thread;
+	const char* format;      // must be a string literal
+	int argCount;
+	LogArg args[LOG_MAX_ARGS];
+	char text[LOG_TEXT_SIZE];
+} LogRecord;
+
+// Receives each formatted record from the drain
+typedef int (*LogSink)(const char* text, const LogRecord* record);
+
+typedef struct {
+	LogRecord records[LOG_RING_SIZE];
+	volatile LONG head;     // next slot to claim
+	LONG tail;              // next slot to drain (drain thread only)
+	volatile LONG dropped;
+	LONG reportedDropped;
+} LogRing;
+
+typedef struct {
+	HANDLE thread;
+	volatile LONG quit;
+	FILE* file;
+	DWORD fileBytes;
+} LogDrain;
+
+// Tune tracing: spans along the tune path (lookup, connect, attach,
+// first decoded audio, first paint) are timestamped with the performance
+// counter into a fixed ring and saved as Chrome trace-event JSON for
+// chrome://tracing. While tracing is off a span costs one load and a
+// branch; while on, one interlocked claim and a few stores
+#define TRACE_EVENTS 4096      // a power of two; oldest overwritten
+#define TRACE_TUNE_THREAD 0    // row for spans that cross threads
+
+typedef struct {
+	volatile LONG sequence;  // one past the claim once written, else 0
+	const char* name;        // must be a string literal
+	RadioStation* station;
+	DWORD thread;
+	LONG tune;
+	LONGLONG start;          // performance counter ticks
+	LONGLONG duration;
+} TraceEvent;
+
+typedef struct {
+	TraceEvent events[TRACE_EVENTS];
+	volatile LONG next;      // next claim
+	volatile LONG enabled;
+	volatile LONG tune;      // numbers the tunes so spans can be grouped
+	// UI thread only: a tune is followed until it is on screen
+	int painting;
+	int audible;
+	LONGLONG attachedAt;
+} Trace;
+
+// Telemetry: every live connection (the playing stream, then the warm
+// standbys) is sampled on the 33 ms UI timer into a fixed ring, so the
+// history covers the last minute or so. Sampling only reads counters
+// BASS already keeps and never waits for a lock
+#define TELEMETRY_HISTORY 2048
+#define TELEMETRY_STREAMS (1 + PREFETCH_MAX_STREAMS)
+#define TELEMETRY_VIEW_TICKS 30  // console summary about once a second
+
+typedef struct {
+	DWORD time;          // GetTickCount
+	float downloadKBps;  // received since the last sample
+	float bufferKB;      // downloaded, not yet decoded
+	float bufferSeconds; // the same at the stream's bitrate
+	float bitrate;       // kbps
+	float cpu;           // BASS_GetCPU, percent
+	DWORD stalls;        // underruns that lasted MIXER_STALL_MS
+	DWORD underruns;     // times the mixer ran dry on this connection
+	float ttfaMs;        // of the connection, once it played
+} TelemetrySample;
+
+typedef struct {
+	HSTREAM stream;
+	RadioStation* station;
+	QWORD lastReceived;
+	LARGE_INTEGER lastAt;
+	float ttfaMs;
+	TelemetrySample samples[TELEMETRY_HISTORY];
+	int count;
+	int next;
+} TelemetryStream;
+
+typedef struct {
+	TelemetryStream streams[TELEMETRY_STREAMS];  // 0 is the playing stream
+	int viewing;
+	int ticks;
+} Telemetry;
+
+// Adaptive buffering: the received byte count of the playing stream is
+// sampled a few times a second to estimate throughput and jitter; from
+// those, and from underruns, each station learns how much to buffer
+// before playing. BASS's own net settings are global and shared by every
+// open, so they stay fixed: a buffer deep enough for the worst link and
+// a small prebuffer, leaving the start to the mixer's per-stream gate
+#define BUFFER_SAMPLE_TICKS 8       // ~260 ms at the 33 ms timer
+#define BUFFER_MIN_SAMPLES 4        // before a profile overrides the defaults
+#define BUFFER_SMOOTHING 0.2f       // EWMA weight of a new sample
+#define BUFFER_BASE_SECONDS 0.25f   // start threshold on a steady link
+#define BUFFER_JITTER_SECONDS 2.0f  // extra seconds per unit of relative jitter
+#define BUFFER_MAX_SECONDS 4.0f     // never wait longer than this to (re)start
+#define BUFFER_MIN_START 2048       // bytes
+#define BUFFER_MAX_START (256 * 1024)
+#define BUFFER_MAX_MARGIN 4.0f
+#define BUFFER_NET_MS 10000        // BASS_CONFIG_NET_BUFFER for every open
+#define BUFFER_NET_PREBUF 10        // percent of it before an open returns
+
+typedef struct {
+	float throughput;  // received bytes per second
+	float jitter;      // mean deviation of the throughput samples
+	float margin;      // grows after underruns, relaxes while steady
+	int samples;
+} BufferProfile;
+
+typedef struct {
+	HSTREAM stream;  // stream being sampled
+	BufferProfile* profile;
+	QWORD lastReceived;
+	LARGE_INTEGER lastAt;
+	int tick;
+	LONG lastUnderruns;
+	DWORD startBytes;  // threshold last posted to the mixer
+	int closed;        // the server has closed this stream's connection
+} BufferController;
+
+// Stream supervisor: reconnects a station that stalls, ends or is
+// freed under us, with jittered exponential backoff, while the static
+// fills in for the missing carrier
+#define STREAM_EVENT_STALLED 0
+#define STREAM_EVENT_RESUMED 1
+#define STREAM_EVENT_ENDED 2
+#define STREAM_EVENT_FREED 3
+#define STREAM_EVENT_META 4
+
+#define RECONNECT_BASE_MS 500
+#define RECONNECT_MAX_MS 30000
+#define RECONNECT_STALL_MS 4000  // a stall this long counts as a drop
+
+typedef struct {
+	int dropped;     // station lost and being reconnected
+	int connecting;  // reconnect attempt in flight
+	int attempts;
+	DWORD droppedAt;
+	DWORD nextAttemptAt;
+	int stalled;
+	DWORD stalledAt;
+	NoiseGenerator jitter;
+
+	// Recovery statistics
+	DWORD stalls;
+	DWORD reconnects;
+	DWORD lastRecoverMs;
+	DWORD worstRecoverMs;
+} StreamSupervisor;
+
 // Audio state
 typedef struct {
 	// BASS handles
-	HSTREAM currentStream;
-	HSTREAM staticStream;
+	HSTREAM currentStream;  // decoding channel feeding the mixer
+	HSTREAM outputStream;   // mixer output
 	int isPlaying;
+	LARGE_INTEGER tuneStart;  // when the current station was requested
 	float staticVolume;
 	float radioVolume;
 
@@ -63,6 +891,8 @@ typedef struct {
 	// VU meter levels (0.0 to 1.0)
 	float vuLevelLeft;
 	float vuLevelRight;
+	float vuPeakLeft;
+	float vuPeakRight;
 } AudioState;
 
 // Radio state
@@ -75,10 +905,55 @@ typedef struct {
 	int isDraggingVolume;
 } RadioState;
 
+// Filter skirt response by detune (one extra entry for interpolation)
+float g_skirtTable[SKIRT_TABLE_SIZE + 1];
+
 // Global console state
 int g_consoleVisible = 0;
 HWND g_consoleWindow = NULL;
 
+// Static noise generator state (only touched by the BASS mixing thread)
+NoiseFillFunc g_noiseFill = NULL;
+AtmosphereState g_atmosphere = {};
+float g_sineTable[SINE_TABLE_SIZE + 1];
+
+// Output rate reported by the device; every stage renders at this rate
+DWORD g_sampleRate = SAMPLE_RATE;
+
+// Mixer state (station fields are swapped under BASS_ChannelLock)
+MixerState g_mixer = {};
+LevelSnapshot g_levels = {};
+MeterState g_meter = {};
+IfFilter g_ifFilter = {};
+IfFilterFunc g_ifFilterRun = NULL;
+
+// Band scope (UI thread only)
+BandScope g_scope = {};
+
+ConnectWorker g_connect = {};
+Tuner g_tuner = {};
+PrefetchPool g_prefetch = {};
+PrefetchRetry g_prefetchRetry[STATION_DIRECTORY_MAX] = {};
+StreamSupervisor g_supervisor = {};
+LatencyHistory g_ttfa = {};
+BufferProfile g_bufferProfiles[STATION_DIRECTORY_MAX] = {};
+BufferController g_buffering = {};
+Timeshift g_timeshift = {};
+StationHealth g_stationHealth[STATION_DIRECTORY_MAX] = {};
+// Read and written on the UI thread only
+char g_nowPlaying[STATION_DIRECTORY_MAX][ICY_TITLE_SIZE] = {};
+HealthProber g_prober = {};
+ConnCache g_connCache = {};
+Telemetry g_telemetry = {};
+LogRing g_log = {};
+LogDrain g_logDrain = {};
+Trace g_trace = {};
+GdiCache g_gdi = {};
+volatile LONG g_ttfaRunning = 0;
+HANDLE g_ttfaHeard = NULL;  // set by CheckFirstAudio while a run waits on it
+float g_ttfaHeardMs = 0.0f;
+StandinServer g_standin = {};
+
 RadioState g_radio = {14.230f, 0.8f, 0, 0, 0, 0};  // Increase default volume to 0.8
 AudioState g_audio = {0};
 
@@ -87,12 +962,14 @@ void DrawRadioInterface(HDC hdc, RECT* rect);
 void DrawTuningDial(HDC hdc, int x, int y, int radius, float frequency);
 void DrawFrequencyDisplay(HDC hdc, int x, int y, float frequency);
 void DrawSignalMeter(HDC hdc, int x, int y, int strength);
-void DrawVUMeter(HDC hdc, int x, int y, float leftLevel, float rightLevel);
+void DrawVUMeter(HDC hdc, int x, int y, float leftLevel, float rightLevel,
+				 float leftPeak, float rightPeak);
 void DrawVolumeKnob(HDC hdc, int x, int y, int radius, float volume);
 void DrawPowerButton(HDC hdc, int x, int y, int radius, int power);
 int IsPointInCircle(int px, int py, int cx, int cy, int radius);
 float GetAngleFromPoint(int px, int py, int cx, int cy);
 void UpdateFrequencyFromMouse(int mouseX, int mouseY);
+void OnFrequencyChanged();
 void UpdateVolumeFromMouse(int mouseX, int mouseY);
 
 // Audio functions
@@ -101,25 +978,301 @@ void CleanupAudio();
 void StartAudio();
 void StopAudio();
 RadioStation* FindNearestStation(float frequency);
+int LoadStationDirectory();
+int LoadStationFile(const char* path);
+int AddStation(float frequency, float power, const char* name,
+			   const char* description, const char* streamUrl);
+const char* StoreStationString(const char* text, int maxLength);
+void BuildStationIndex(StationIndex* index, const float* keys, int count,
+					   int* buckets, int maxBuckets);
+int StationIndexBucket(const StationIndex* index, float frequency);
+int StationIndexLowerBound(const StationIndex* index, float frequency);
+int StationIndexNearest(const StationIndex* index, float frequency);
+int StationIndexNearby(const StationIndex* index, float frequency,
+					   float range, int* nearest, int max);
 float GetStationSignalStrength(RadioStation* station, float currentFreq);
+void UpdateSignalStrength();
+
+// Propagation model functions
+void InitPropagationTables();
+float SkirtResponseAnalytic(float detune);
+float SkirtResponse(float detune);
+float IonosphericFading(RadioStation* station, DWORD timeMs);
 
 // BASS streaming functions
 int StartBassStreaming(RadioStation* station);
 void StopBassStreaming();
 
+// Tuner functions
+int TunerStep(Tuner* tuner, RadioStation* station, int strength, DWORD now);
+void TunerUpdate();
+void TunerReset(Tuner* tuner);
+void TunerConnectFailed(Tuner* tuner, RadioStation* station);
+
+// Connect worker functions
+int StartConnectWorker(HWND notify);
+void StopConnectWorker();
+void ConnectRequest(RadioStation* station);
+void ConnectCancel();
+LONG ConnectGeneration();
+int WaitForNetWorker(HANDLE thread, const char* name);
+DWORD WINAPI ConnectWorkerProc(LPVOID param);
+void OnStationReady(LONG generation, HSTREAM stream);
+void AttachStation(HSTREAM stream, const char* source);
+
+// Stream supervisor functions
+void SupervisorWatch(HSTREAM stream);
+void CALLBACK StreamSyncProc(HSYNC handle, DWORD channel, DWORD data,
+							 void* user);
+void OnStreamEvent(int event, HSTREAM stream);
+void SupervisorDrop(const char* reason);
+void SupervisorTick(DWORD now);
+void SupervisorReset();
+int SupervisorConnectFailed();
+DWORD SupervisorBackoff(int attempts);
+
+// Timeshift functions
+int TimeshiftOpen(Timeshift* ts, DWORD seconds, DWORD sampleRate);
+void TimeshiftClose(Timeshift* ts);
+int TimeshiftStartWriter(Timeshift* ts);
+DWORD WINAPI TimeshiftWriterProc(LPVOID param);
+void TimeshiftDrain(Timeshift* ts);
+void TimeshiftLoadReplay(Timeshift* ts);
+void TimeshiftWant(Timeshift* ts, ULONGLONG frame);
+void TimeshiftReplayRun(const short* src, float* samples, DWORD frames);
+void TimeshiftCapture(Timeshift* ts, const float* samples, DWORD frames);
+void TimeshiftReplay(Timeshift* ts, float* samples, DWORD frames);
+void TimeshiftPause();
+void TimeshiftRewind(DWORD seconds);
+void TimeshiftGoLive();
+
+// Health prober functions
+int GetAppFilePath(const char* name, char* path);
+DWORD HashStationUrl(const char* url);
+StationHealth* GetStationHealth(RadioStation* station);
+void ReadStationHealth(RadioStation* station, StationHealth* health);
+void StoreStationHealth(RadioStation* station, const StationHealth* health);
+int IsStationOffAir(RadioStation* station);
+const char* HealthErrorName(int error);
+const char* HealthStatusName(int status);
+const char* HealthCodecName(DWORD ctype);
+int ProbeStation(RadioStation* station, StationHealth* health);
+void CALLBACK ProbeDownloadProc(const void* buffer, DWORD length, void* user);
+DWORD WINAPI HealthProbeProc(LPVOID param);
+int StartHealthProbe(int force);
+void StopHealthProbe();
+int LoadHealthCache();
+int SaveHealthCache();
+
+// Connection cache functions
+int InitConnCache();
+void CleanupConnCache();
+ConnCacheEntry* ConnCacheFind(DWORD urlHash);
+int ConnCacheLookup(const char* url, char* target, int* hops);
+void ConnCacheStore(const ConnCacheEntry* entry);
+void ConnCacheForget(const char* url);
+int ConnCacheIsFresh(const char* url);
+int ResolveStreamUrl(const char* url, ConnCacheEntry* entry);
+int ParsePlaylistTarget(const char* body, char* target, int size);
+void ResolveHostAddress(const char* url, char* address);
+HSTREAM OpenStationStream(RadioStation* station, DWORD flags,
+						  DOWNLOADPROC* proc, void* user);
+int LoadConnCache();
+int SaveConnCache();
+
+// Logging functions
+void Log(const char* format, ...);
+void LogRingInit(LogRing* ring);
+int LogWrite(LogRing* ring, const char* format, va_list args);
+int LogFormat(const LogRecord* record, char* out, int size);
+int LogDrainRing(LogRing* ring, char* buffer, int size, LogSink sink);
+int LogSinkOutput(const char* text, const LogRecord* record);
+DWORD WINAPI LogDrainProc(LPVOID param);
+int StartLogging();
+void StopLogging();
+
+// Tune trace functions
+LONGLONG TraceBegin(Trace* trace);
+LONGLONG TraceEnd(Trace* trace, const char* name, RadioStation* station,
+				  LONGLONG start);
+void TraceRecord(Trace* trace, const char* name, RadioStation* station,
+				 DWORD thread, LONGLONG start, LONGLONG end);
+void TraceEnable(int enabled);
+void TraceTuneStarted();
+void TraceFirstAudio(LONGLONG at);
+void TracePainted(LONGLONG start);
+void TraceWriteString(FILE* file, const char* text);
+int TraceExportJson();
+
+// Telemetry functions
+void TelemetryTick();
+void TelemetrySampleStream(TelemetryStream* slot, HSTREAM stream,
+						   RadioStation* station, float cpu);
+void TelemetryFirstAudio(float ms);
+float TelemetryPercentile(TelemetryStream* slot, size_t field,
+						  float percentile);
+void TelemetryPrint();
+int TelemetryExportCsv();
+int CompareFloats(const void* a, const void* b);
+
+// Buffer controller functions
+BufferProfile* GetBufferProfile(RadioStation* station);
+void BufferControllerAttach(HSTREAM stream, RadioStation* station);
+void BufferControllerTick();
+DWORD BufferStartBytes(BufferProfile* profile, float bytesPerSecond);
+
+// ICY metadata functions
+int IcyParseTitle(const char* meta, char* title, int titleSize);
+void UpdateNowPlaying(HSTREAM stream);
+char* GetNowPlaying(RadioStation* station);
+
+// Time to first audio functions
+void LatencyRecord(LatencyHistory* history, float ms);
+float LatencyPercentile(LatencyHistory* history, float percentile);
+void CheckFirstAudio();
+void StartTtfaMeasurement();
+DWORD WINAPI TtfaMeasurementProc(LPVOID param);
+double GetThreadCpuSeconds();
+double GetProcessCpuSeconds();
+
+// Stand-in server functions
+int StandinStart();
+void StandinStop();
+RadioStation* StandinStation(int profile);
+DWORD WINAPI StandinServerProc(LPVOID param);
+DWORD WINAPI StandinConnectionProc(LPVOID param);
+const StandinProfile* StandinFindProfile(const char* request);
+void StandinServe(SOCKET client, const StandinProfile* profile);
+void StandinFillAudio(char* out, DWORD offset, DWORD count);
+int StandinSend(SOCKET client, const char* data, int length);
+int StandinWait(DWORD ms);
+
+// Prefetch functions
+int StartPrefetchWorker();
+void StopPrefetchWorker();
+void PrefetchUpdate(float frequency);
+void PrefetchSetWanted(RadioStation** wanted, int count);
+HSTREAM PrefetchTake(RadioStation* station);
+int PrefetchIsWanted(PrefetchPool* pool, RadioStation* station);
+int PrefetchCanTry(RadioStation* station, DWORD now);
+void PrefetchFailed(RadioStation* station, DWORD now);
+DWORD WINAPI PrefetchWorkerProc(LPVOID param);
+void PrintStreamError(RadioStation* station, DWORD error);
+
+// Mixer functions
+DWORD CALLBACK MixerStreamProc(HSTREAM handle, void* buffer, DWORD length,
+							   void* user);
+int StartMixer();
+void StopMixer();
+void MixerSetStation(HSTREAM station);
+void MixerReadStation(MixerState* mixer, float* out, DWORD frames);
+void MixerAttach(MixerState* mixer, HSTREAM station, DWORD sampleRate);
+int MixerPull(MixerState* mixer);
+
+// Parameter smoothing functions
+void SmoothedParamInit(SmoothedParam* param, int mode, float seconds,
+					   float sampleRate, float value);
+void SmoothedParamJump(SmoothedParam* param, float value);
+void SmoothedParamRender(SmoothedParam* param, float target, float* out,
+						 DWORD count);
+
+// IF filter functions
+void IfFilterReset(IfFilter* filter, int sections, float sampleRate);
+void IfFilterProcess(IfFilter* filter, float* samples, DWORD frames,
+					 float detune);
+void IfFilterBeginBlock(IfFilter* filter, float detune);
+void IfFilterDesign(BiquadCoefs* coef, int highPass, float cutoff,
+					float sampleRate);
+void IfFilterRunScalar(IfFilter* filter, float* samples, DWORD frames);
+void IfFilterRunSSE2(IfFilter* filter, float* samples, DWORD frames);
+IfFilterFunc SelectIfFilter();
+int MixerNextStationFrame(MixerState* mixer);
+
 // Static noise functions
-DWORD CALLBACK StaticStreamProc(HSTREAM handle, void* buffer, DWORD length, void* user);
 void StartStaticNoise();
 void StopStaticNoise();
 void UpdateStaticVolume(float signalStrength);
 void UpdateStreamVolume();
 
+// Band scope functions
+int InitBandScope();
+void CleanupBandScope();
+void UpdateBandScope();
+void RenderBandScope();
+void DrawBandScope(HDC hdc, int x, int y);
+
+// GDI cache functions
+void InitGdiCache();
+void CleanupGdiCache();
+HPEN CachedPen(int width, COLORREF color);
+HBRUSH CachedBrush(COLORREF color);
+HFONT CachedFont(int height, DWORD pitchAndFamily, const char* face);
+HGDIOBJ GdiCacheObject(DWORD key, int width, COLORREF color);
+HGDIOBJ GdiCacheTransient(HGDIOBJ object);
+void GdiReleaseTransient(HDC hdc);
+
 // VU meter functions
 void UpdateVULevels();
+void MeterBlock(const float* samples, DWORD frames);
+void MeterReset();
+void ReadLevels(float* peak, float* rms);
+
+// Noise generator functions
+void NoiseSeed(NoiseGenerator* gen, DWORD seed);
+void NoiseFillScalar(NoiseGenerator* gen, float* out, DWORD count, float gain);
+void NoiseFillSSE2(NoiseGenerator* gen, float* out, DWORD count, float gain);
+NoiseFillFunc SelectNoiseFill();
+float NoiseRandomUnit(NoiseGenerator* gen);
+
+// LFO functions
+void InitSineTable();
+void LfoBankReset(LfoBank* bank);
+void LfoBankAdd(LfoBank* bank, float rateHz, float depth, float sampleRate);
+float LfoBankGain(LfoBank* bank);
+void LfoBankAdvance(LfoBank* bank, DWORD samples);
+float SineLookup(DWORD phase);
+
+// Atmosphere synthesizer functions
+void AtmosphereReset(AtmosphereState* state, DWORD seed, float sampleRate);
+void AtmosphereRender(AtmosphereState* state, float* out, DWORD count,
+					  float dialFrequency);
+void AtmosphereBeginBlock(AtmosphereState* state, float dialFrequency);
+void AtmosphereScheduleCrackle(AtmosphereState* state);
+
+// Debug console functions
+void ShowDebugConsole();
+void RunBenchmarks();
+double GetElapsedSeconds(LARGE_INTEGER start);
+void BenchmarkNoiseGenerator();
+void BenchmarkAtmosphere();
+void BenchmarkBandScope();
+void BenchmarkPropagation();
+void BenchmarkIfFilter();
+void BenchmarkStationPath();
+void BenchmarkTuner();
+void BenchmarkIcyParser();
+void BenchmarkTimeshift();
+void BenchmarkStationDirectory();
+void BenchmarkLogging();
+void BenchmarkTrace();
+void BenchmarkFrame();
+DWORD CALLBACK BenchmarkSourceProc(HSTREAM handle, void* buffer, DWORD length,
+								   void* user);
+void BenchmarkPipeline();
+DWORD CALLBACK PipelineShortProc(HSTREAM handle, void* buffer, DWORD length,
+								 void* user);
+DWORD CALLBACK PipelineMixerProc(HSTREAM handle, void* buffer, DWORD length,
+								 void* user);
 
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int nCmdShow) {
 	// Don't allocate console by default - will be toggled via menu
 
+	// Before anything logs; the drain thread needs nothing else
+	LogRingInit(&g_log);
+	StartLogging();
+	LoadStationDirectory();
+	InitGdiCache();
+
 	const char* CLASS_NAME = "ShortwaveRadio";
 
 	WNDCLASS wc = {};
@@ -143,15 +1296,33 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int nCmdShow) {
 	);
 
 	if (hwnd == NULL) {
+		StopLogging();
 		return 0;
 	}
 
 	// Initialize audio system
 	if (InitializeAudio() != 0) {
 		MessageBox(hwnd, "Failed to initialize audio system", "Error", MB_OK | MB_ICONERROR);
+		StopLogging();
+		return 0;
+	}
+
+	// Shared by the connect, prefetch and probe threads
+	InitConnCache();
+	LoadConnCache();
+
+	if (!StartConnectWorker(hwnd) || !StartPrefetchWorker()) {
+		MessageBox(hwnd, "Failed to start connect thread", "Error",
+				   MB_OK | MB_ICONERROR);
+		StopLogging();
 		return 0;
 	}
 
+	// Re-check stations whose cached health is missing or stale
+	InitializeCriticalSection(&g_prober.lock);
+	LoadHealthCache();
+	StartHealthProbe(0);
+
 	// Audio starts when power button is pressed
 
 	// Create menu
@@ -160,6 +1331,19 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int nCmdShow) {
 	// Radio menu
 	HMENU hRadioMenu = CreatePopupMenu();
 	AppendMenu(hRadioMenu, MF_STRING, ID_TOGGLE_CONSOLE, "&Debug Console");
+	AppendMenu(hRadioMenu, MF_STRING, ID_RUN_BENCHMARKS, "Run &Benchmarks");
+	AppendMenu(hRadioMenu, MF_STRING, ID_MEASURE_TTFA,
+			   "Measure Time to &First Audio");
+	AppendMenu(hRadioMenu, MF_STRING, ID_PROBE_STATIONS, "&Probe Stations");
+	AppendMenu(hRadioMenu, MF_STRING, ID_TELEMETRY_VIEW, "Show &Telemetry");
+	AppendMenu(hRadioMenu, MF_STRING, ID_TELEMETRY_EXPORT,
+			   "&Export Telemetry CSV");
+	AppendMenu(hRadioMenu, MF_STRING, ID_TRACE_ENABLE, "Trace T&unes");
+	AppendMenu(hRadioMenu, MF_STRING, ID_TRACE_EXPORT, "&Save Tune Trace");
+	AppendMenu(hRadioMenu, MF_SEPARATOR, 0, NULL);
+	AppendMenu(hRadioMenu, MF_STRING, ID_TIMESHIFT_PAUSE, "&Pause/Resume\tP");
+	AppendMenu(hRadioMenu, MF_STRING, ID_TIMESHIFT_REWIND, "&Rewind 10 s\tR");
+	AppendMenu(hRadioMenu, MF_STRING, ID_TIMESHIFT_LIVE, "Back to &Live\tL");
 	AppendMenu(hRadioMenu, MF_SEPARATOR, 0, NULL);
 	AppendMenu(hRadioMenu, MF_STRING, ID_ABOUT, "&About");
 	AppendMenu(hRadioMenu, MF_SEPARATOR, 0, NULL);
@@ -181,8 +1365,15 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int nCmdShow) {
 	}
 
 	// Cleanup audio
+	StopHealthProbe();
+	StopPrefetchWorker();
+	StopConnectWorker();
 	StopAudio();
 	CleanupAudio();
+	CleanupConnCache();
+	CleanupBandScope();
+	CleanupGdiCache();
+	StopLogging();
 
 	// Cleanup console if it exists
 	if (g_consoleWindow) {
@@ -203,6 +1394,8 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
 			return 0;
 
 		case WM_PAINT: {
+			// Repaints are only traced while a tune is on its way to the screen
+			LONGLONG traceStart = g_trace.painting ? TraceBegin(&g_trace) : 0;
 			PAINTSTRUCT ps;
 			HDC hdc = BeginPaint(hwnd, &ps);
 
@@ -230,6 +1423,7 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
 			DeleteDC(memDC);
 
 			EndPaint(hwnd, &ps);
+			TracePainted(traceStart);
 			return 0;
 		}
 
@@ -258,6 +1452,8 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
 					StartAudio();
 				} else {
 					StopAudio();
+					TunerReset(&g_tuner);
+					PrefetchSetWanted(NULL, 0);
 				}
 				InvalidateRect(hwnd, NULL, TRUE);
 			}
@@ -296,24 +1492,7 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
 					g_radio.frequency += 0.1f;
 					if (g_radio.frequency > 34.0f) g_radio.frequency = 34.0f;
 
-					// Update signal strength for new frequency
-					RadioStation* station = FindNearestStation(g_radio.frequency);
-					if (station) {
-						g_radio.signalStrength = (int)(GetStationSignalStrength(station, g_radio.frequency) * 100.0f);
-						if (g_radio.signalStrength > 50 && station != g_audio.currentStation) {
-							StopBassStreaming();
-							StartBassStreaming(station);
-						}
-					} else {
-						g_radio.signalStrength = 5 + (int)(15.0f * sin(g_radio.frequency));
-						StopBassStreaming();
-					}
-
-					if (g_radio.signalStrength < 0) g_radio.signalStrength = 0;
-					if (g_radio.signalStrength > 100) g_radio.signalStrength = 100;
-
-					UpdateStaticVolume(g_radio.signalStrength);
-					UpdateStreamVolume();
+					OnFrequencyChanged();
 					InvalidateRect(hwnd, NULL, TRUE);
 					break;
 				}
@@ -323,24 +1502,7 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
 					g_radio.frequency -= 0.1f;
 					if (g_radio.frequency < 10.0f) g_radio.frequency = 10.0f;
 
-					// Update signal strength for new frequency
-					RadioStation* station = FindNearestStation(g_radio.frequency);
-					if (station) {
-						g_radio.signalStrength = (int)(GetStationSignalStrength(station, g_radio.frequency) * 100.0f);
-						if (g_radio.signalStrength > 50 && station != g_audio.currentStation) {
-							StopBassStreaming();
-							StartBassStreaming(station);
-						}
-					} else {
-						g_radio.signalStrength = 5 + (int)(15.0f * sin(g_radio.frequency));
-						StopBassStreaming();
-					}
-
-					if (g_radio.signalStrength < 0) g_radio.signalStrength = 0;
-					if (g_radio.signalStrength > 100) g_radio.signalStrength = 100;
-
-					UpdateStaticVolume(g_radio.signalStrength);
-					UpdateStreamVolume();
+					OnFrequencyChanged();
 					InvalidateRect(hwnd, NULL, TRUE);
 					break;
 				}
@@ -350,24 +1512,7 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
 					g_radio.frequency += 1.0f;
 					if (g_radio.frequency > 34.0f) g_radio.frequency = 34.0f;
 
-					// Update signal strength for new frequency
-					RadioStation* station = FindNearestStation(g_radio.frequency);
-					if (station) {
-						g_radio.signalStrength = (int)(GetStationSignalStrength(station, g_radio.frequency) * 100.0f);
-						if (g_radio.signalStrength > 50 && station != g_audio.currentStation) {
-							StopBassStreaming();
-							StartBassStreaming(station);
-						}
-					} else {
-						g_radio.signalStrength = 5 + (int)(15.0f * sin(g_radio.frequency));
-						StopBassStreaming();
-					}
-
-					if (g_radio.signalStrength < 0) g_radio.signalStrength = 0;
-					if (g_radio.signalStrength > 100) g_radio.signalStrength = 100;
-
-					UpdateStaticVolume(g_radio.signalStrength);
-					UpdateStreamVolume();
+					OnFrequencyChanged();
 					InvalidateRect(hwnd, NULL, TRUE);
 					break;
 				}
@@ -377,27 +1522,22 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
 					g_radio.frequency -= 1.0f;
 					if (g_radio.frequency < 10.0f) g_radio.frequency = 10.0f;
 
-					// Update signal strength for new frequency
-					RadioStation* station = FindNearestStation(g_radio.frequency);
-					if (station) {
-						g_radio.signalStrength = (int)(GetStationSignalStrength(station, g_radio.frequency) * 100.0f);
-						if (g_radio.signalStrength > 50 && station != g_audio.currentStation) {
-							StopBassStreaming();
-							StartBassStreaming(station);
-						}
-					} else {
-						g_radio.signalStrength = 5 + (int)(15.0f * sin(g_radio.frequency));
-						StopBassStreaming();
-					}
-
-					if (g_radio.signalStrength < 0) g_radio.signalStrength = 0;
-					if (g_radio.signalStrength > 100) g_radio.signalStrength = 100;
-
-					UpdateStaticVolume(g_radio.signalStrength);
-					UpdateStreamVolume();
+					OnFrequencyChanged();
 					InvalidateRect(hwnd, NULL, TRUE);
 					break;
 				}
+
+				case 'P':
+					TimeshiftPause();
+					break;
+
+				case 'R':
+					TimeshiftRewind(TIMESHIFT_REWIND_SECONDS);
+					break;
+
+				case 'L':
+					TimeshiftGoLive();
+					break;
 			}
 			return 0;
 		}
@@ -412,23 +1552,61 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
 						}
 						g_consoleVisible = 0;
 					} else {
-						// Show console
-						if (!g_consoleWindow) {
-							// First time - allocate console
-							AllocConsole();
-							freopen("CONOUT$", "w", stdout);
-							freopen("CONOUT$", "w", stderr);
-							g_consoleWindow = GetConsoleWindow();
-							printf("Shortwave Radio Debug Console\n");
-							printf("=============================\n");
-						} else {
-							// Console exists, just show it
-							ShowWindow(g_consoleWindow, SW_SHOW);
-						}
-						g_consoleVisible = 1;
+						ShowDebugConsole();
 					}
 					break;
 				}
+				case ID_RUN_BENCHMARKS: {
+					// Results go to the debug console
+					ShowDebugConsole();
+					RunBenchmarks();
+					break;
+				}
+				case ID_TIMESHIFT_PAUSE:
+					TimeshiftPause();
+					break;
+				case ID_TIMESHIFT_REWIND:
+					TimeshiftRewind(TIMESHIFT_REWIND_SECONDS);
+					break;
+				case ID_TIMESHIFT_LIVE:
+					TimeshiftGoLive();
+					break;
+				case ID_MEASURE_TTFA: {
+					// Needs the network, so it runs on its own thread
+					ShowDebugConsole();
+					StartTtfaMeasurement();
+					break;
+				}
+				case ID_TELEMETRY_VIEW: {
+					g_telemetry.viewing = !g_telemetry.viewing;
+					UINT check = g_telemetry.viewing ? MF_CHECKED
+													 : MF_UNCHECKED;
+					CheckMenuItem(GetMenu(hwnd), ID_TELEMETRY_VIEW,
+								  MF_BYCOMMAND | check);
+					if (g_telemetry.viewing) ShowDebugConsole();
+					break;
+				}
+				case ID_TELEMETRY_EXPORT:
+					ShowDebugConsole();
+					TelemetryExportCsv();
+					break;
+				case ID_TRACE_ENABLE: {
+					TraceEnable(!g_trace.enabled);
+					UINT check = g_trace.enabled ? MF_CHECKED : MF_UNCHECKED;
+					CheckMenuItem(GetMenu(hwnd), ID_TRACE_ENABLE,
+								  MF_BYCOMMAND | check);
+					break;
+				}
+				case ID_TRACE_EXPORT:
+					ShowDebugConsole();
+					TraceExportJson();
+					break;
+				case ID_PROBE_STATIONS:
+					ShowDebugConsole();
+					if (!StartHealthProbe(1)) {
+						Log("Station probe already running\n");
+					}
+					break;
 				case ID_ABOUT: {
 					const char* aboutText = "Shortwave Radio Tuner\n\n"
 										  "Version: 1.0.0\n"
@@ -444,7 +1622,9 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
 										  "- UP/DOWN arrows: Fine tuning (0.1 MHz)\n"
 										  "- LEFT/RIGHT arrows: Coarse tuning (1.0 MHz)\n"
 										  "- Click power button to turn on/off\n"
-										  "- Drag volume knob to adjust volume";
+										  "- Drag volume knob to adjust volume\n"
+										  "- P: pause, R: rewind 10 s\n"
+										  "- L: back to live";
 					MessageBox(hwnd, aboutText, "About Shortwave Radio",
 							  MB_OK | MB_ICONINFORMATION);
 					break;
@@ -455,11 +1635,63 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
 			}
 			return 0;
 
+		case WM_STATION_READY:
+			OnStationReady((LONG)wParam, (HSTREAM)lParam);
+			return 0;
+
+		case WM_STREAM_EVENT:
+			OnStreamEvent((int)wParam, (HSTREAM)lParam);
+			return 0;
+
+		case WM_TTFA_TUNE:
+			// The run owns the tuner; ending it hands the dial back. Titles
+			// are UI thread state, so they are cleared and reported here
+			if (lParam) {
+				GetNowPlaying((RadioStation*)lParam)[0] = '\0';
+				StartBassStreaming((RadioStation*)lParam);
+			} else {
+				RadioStation* station = g_audio.currentStation;
+				const char* title = station ? GetNowPlaying(station) : "";
+				if (title[0]) {
+					Log("  %-10s now playing: %s\n", "", title);
+				}
+				StopBassStreaming();
+				TunerReset(&g_tuner);
+			}
+			return 0;
+
 		case WM_TIMER: {
 			// Timer for VU meter updates - only invalidate VU meter area
 			if (g_radio.power) {
 				RECT vuRect = {440, 190, 540, 250};
 				InvalidateRect(hwnd, &vuRect, FALSE);
+
+				// Follow ionospheric fading; the tuner's timers run off
+				// this tick
+				int oldStrength = g_radio.signalStrength;
+				UpdateSignalStrength();
+				TunerUpdate();
+				PrefetchUpdate(g_radio.frequency);
+				SupervisorTick(GetTickCount());
+				CheckFirstAudio();
+				BufferControllerTick();
+				TelemetryTick();
+				if (g_radio.signalStrength != oldStrength) {
+					UpdateStaticVolume(g_radio.signalStrength);
+					UpdateStreamVolume();
+					RECT signalRect = {448, 152, 532, 192};
+					InvalidateRect(hwnd, &signalRect, FALSE);
+					if ((oldStrength > 30) != (g_radio.signalStrength > 30)) {
+						InvalidateRect(hwnd, &g_stationStrip, FALSE);
+					}
+				}
+
+				// One waterfall row per tick, independent of repaints
+				UpdateBandScope();
+				RECT scopeRect = {SCOPE_X - 2, SCOPE_Y - 2,
+								  SCOPE_X + SCOPE_WIDTH + 2,
+								  SCOPE_Y + SCOPE_HEIGHT + 2};
+				InvalidateRect(hwnd, &scopeRect, FALSE);
 			}
 			return 0;
 		}
@@ -470,9 +1702,8 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
 
 void DrawRadioInterface(HDC hdc, RECT* rect) {
 	// Winamp-style dark gradient background
-	HBRUSH darkBrush = CreateSolidBrush(RGB(24, 24, 24));
+	HBRUSH darkBrush = CachedBrush(RGB(24, 24, 24));
 	FillRect(hdc, rect, darkBrush);
-	DeleteObject(darkBrush);
 
 	// Main panel with simplified metallic gradient effect
 	RECT panel = {10, 10, rect->right - 10, rect->bottom - 10};
@@ -480,21 +1711,19 @@ void DrawRadioInterface(HDC hdc, RECT* rect) {
 	// Simplified gradient effect with fewer steps
 	for (int i = 0; i < 8; i++) {
 		int gray = 45 + i * 3;
-		HBRUSH gradBrush = CreateSolidBrush(RGB(gray, gray, gray));
+		HBRUSH gradBrush = CachedBrush(RGB(gray, gray, gray));
 		RECT gradRect = {panel.left + i, panel.top + i, panel.right - i, panel.bottom - i};
 		FrameRect(hdc, &gradRect, gradBrush);
-		DeleteObject(gradBrush);
 	}
 
 	// Inner panel with darker metallic look
 	RECT innerPanel = {30, 30, rect->right - 30, rect->bottom - 30};
-	HBRUSH innerBrush = CreateSolidBrush(RGB(32, 32, 32));
+	HBRUSH innerBrush = CachedBrush(RGB(32, 32, 32));
 	FillRect(hdc, &innerPanel, innerBrush);
-	DeleteObject(innerBrush);
 
 	// Winamp-style beveled border
-	HPEN lightPen = CreatePen(PS_SOLID, 1, RGB(128, 128, 128));
-	HPEN darkPen = CreatePen(PS_SOLID, 1, RGB(16, 16, 16));
+	HPEN lightPen = CachedPen(1, RGB(128, 128, 128));
+	HPEN darkPen = CachedPen(1, RGB(16, 16, 16));
 
 	SelectObject(hdc, lightPen);
 	MoveToEx(hdc, innerPanel.left, innerPanel.bottom, NULL);
@@ -505,9 +1734,6 @@ void DrawRadioInterface(HDC hdc, RECT* rect) {
 	LineTo(hdc, innerPanel.right, innerPanel.bottom);
 	LineTo(hdc, innerPanel.left, innerPanel.bottom);
 
-	DeleteObject(lightPen);
-	DeleteObject(darkPen);
-
 	// Draw frequency display with Winamp-style LCD
 	DrawFrequencyDisplay(hdc, 200, 80, g_radio.frequency);
 
@@ -521,7 +1747,11 @@ void DrawRadioInterface(HDC hdc, RECT* rect) {
 	DrawSignalMeter(hdc, 450, 170, g_radio.signalStrength);
 
 	// Draw VU meter with classic Winamp style
-	DrawVUMeter(hdc, 450, 200, g_audio.vuLevelLeft, g_audio.vuLevelRight);
+	DrawVUMeter(hdc, 450, 200, g_audio.vuLevelLeft, g_audio.vuLevelRight,
+				g_audio.vuPeakLeft, g_audio.vuPeakRight);
+
+	// Draw band scope below the meters
+	DrawBandScope(hdc, SCOPE_X, SCOPE_Y);
 
 	// Draw power button with LED glow
 	DrawPowerButton(hdc, 500, 120, 25, g_radio.power);
@@ -529,46 +1759,46 @@ void DrawRadioInterface(HDC hdc, RECT* rect) {
 	// Draw station info with Winamp-style ticker
 	RadioStation* currentStation = FindNearestStation(g_radio.frequency);
 	if (currentStation && g_radio.signalStrength > 30) {
-		RECT stationRect = {50, 320, 550, 360};
+		// Border on the last row and column, inside the rectangle
+		const RECT* strip = &g_stationStrip;
+		int right = strip->right - 1;
+		int bottom = strip->bottom - 1;
 
 		// Winamp-style display background
-		HBRUSH displayBrush = CreateSolidBrush(RGB(0, 0, 0));
-		FillRect(hdc, &stationRect, displayBrush);
-		DeleteObject(displayBrush);
+		HBRUSH displayBrush = CachedBrush(RGB(0, 0, 0));
+		FillRect(hdc, strip, displayBrush);
 
 		// Beveled border
-		HPEN lightBorderPen = CreatePen(PS_SOLID, 1, RGB(64, 64, 64));
-		HPEN darkBorderPen = CreatePen(PS_SOLID, 1, RGB(0, 0, 0));
+		HPEN lightBorderPen = CachedPen(1, RGB(64, 64, 64));
+		HPEN darkBorderPen = CachedPen(1, RGB(0, 0, 0));
 
 		SelectObject(hdc, darkBorderPen);
-		MoveToEx(hdc, stationRect.left, stationRect.bottom, NULL);
-		LineTo(hdc, stationRect.left, stationRect.top);
-		LineTo(hdc, stationRect.right, stationRect.top);
+		MoveToEx(hdc, strip->left, bottom, NULL);
+		LineTo(hdc, strip->left, strip->top);
+		LineTo(hdc, right, strip->top);
 
 		SelectObject(hdc, lightBorderPen);
-		LineTo(hdc, stationRect.right, stationRect.bottom);
-		LineTo(hdc, stationRect.left, stationRect.bottom);
-
-		DeleteObject(lightBorderPen);
-		DeleteObject(darkBorderPen);
+		LineTo(hdc, right, bottom);
+		LineTo(hdc, strip->left, bottom);
 
 		// Winamp-style green text
 		SetTextColor(hdc, RGB(0, 255, 0));
 		SetBkMode(hdc, TRANSPARENT);
-		HFONT stationFont = CreateFont(14, 0, 0, 0, FW_BOLD, FALSE, FALSE, FALSE,
-									  DEFAULT_CHARSET, OUT_DEFAULT_PRECIS,
-									  CLIP_DEFAULT_PRECIS, DEFAULT_QUALITY,
-									  DEFAULT_PITCH | FF_MODERN, "Tahoma");
+		HFONT stationFont = CachedFont(14, DEFAULT_PITCH | FF_MODERN, "Tahoma");
 		SelectObject(hdc, stationFont);
 
+		// Song title when the stream has sent one, else the description
 		char stationText[256];
-		sprintf(stationText, "%.3f MHz - %s: %s",
-				currentStation->frequency, currentStation->name, currentStation->description);
+		const char* title = GetNowPlaying(currentStation);
+		const char* detail = title[0] ? title : currentStation->description;
+		if (IsStationOffAir(currentStation)) detail = "off air";
+		_snprintf(stationText, sizeof(stationText) - 1, "%.3f MHz - %s: %s",
+				  currentStation->frequency, currentStation->name, detail);
+		stationText[sizeof(stationText) - 1] = '\0';
 
 		SetTextAlign(hdc, TA_LEFT);
-		TextOut(hdc, stationRect.left + 10, stationRect.top + 12, stationText, strlen(stationText));
-
-		DeleteObject(stationFont);
+		TextOut(hdc, strip->left + 10, strip->top + 12, stationText,
+				strlen(stationText));
 	}
 }
 
@@ -577,13 +1807,12 @@ void DrawFrequencyDisplay(HDC hdc, int x, int y, float frequency) {
 	RECT display = {x - 100, y - 25, x + 100, y + 25};
 
 	// Dark background
-	HBRUSH blackBrush = CreateSolidBrush(RGB(0, 0, 0));
+	HBRUSH blackBrush = CachedBrush(RGB(0, 0, 0));
 	FillRect(hdc, &display, blackBrush);
-	DeleteObject(blackBrush);
 
 	// Beveled border effect
-	HPEN lightPen = CreatePen(PS_SOLID, 2, RGB(96, 96, 96));
-	HPEN darkPen = CreatePen(PS_SOLID, 2, RGB(32, 32, 32));
+	HPEN lightPen = CachedPen(2, RGB(96, 96, 96));
+	HPEN darkPen = CachedPen(2, RGB(32, 32, 32));
 
 	SelectObject(hdc, darkPen);
 	MoveToEx(hdc, display.left, display.bottom, NULL);
@@ -594,15 +1823,11 @@ void DrawFrequencyDisplay(HDC hdc, int x, int y, float frequency) {
 	LineTo(hdc, display.right, display.bottom);
 	LineTo(hdc, display.left, display.bottom);
 
-	DeleteObject(lightPen);
-	DeleteObject(darkPen);
-
 	// Inner shadow
 	RECT innerDisplay = {display.left + 3, display.top + 3, display.right - 3, display.bottom - 3};
-	HPEN shadowPen = CreatePen(PS_SOLID, 1, RGB(16, 16, 16));
+	HPEN shadowPen = CachedPen(1, RGB(16, 16, 16));
 	SelectObject(hdc, shadowPen);
 	Rectangle(hdc, innerDisplay.left, innerDisplay.top, innerDisplay.right, innerDisplay.bottom);
-	DeleteObject(shadowPen);
 
 	// Frequency text with glow effect
 	char freqText[32];
@@ -611,10 +1836,7 @@ void DrawFrequencyDisplay(HDC hdc, int x, int y, float frequency) {
 	SetBkMode(hdc, TRANSPARENT);
 
 	// Create glow effect by drawing text multiple times with slight offsets
-	HFONT lcdFont = CreateFont(20, 0, 0, 0, FW_BOLD, FALSE, FALSE, FALSE,
-							  DEFAULT_CHARSET, OUT_DEFAULT_PRECIS,
-							  CLIP_DEFAULT_PRECIS, DEFAULT_QUALITY,
-							  FIXED_PITCH | FF_MODERN, "Consolas");
+	HFONT lcdFont = CachedFont(20, FIXED_PITCH | FF_MODERN, "Consolas");
 	SelectObject(hdc, lcdFont);
 	SetTextAlign(hdc, TA_CENTER);
 
@@ -631,43 +1853,35 @@ void DrawFrequencyDisplay(HDC hdc, int x, int y, float frequency) {
 	// Main text (bright green)
 	SetTextColor(hdc, RGB(0, 255, 0));
 	TextOut(hdc, x, y - 10, freqText, strlen(freqText));
-
-	DeleteObject(lcdFont);
 }
 
 void DrawTuningDial(HDC hdc, int x, int y, int radius, float frequency) {
 	// Simplified metallic dial with fewer gradient steps
 	for (int i = 0; i < 4; i++) {
 		int gray = 80 + i * 20;
-		HBRUSH gradBrush = CreateSolidBrush(RGB(gray, gray, gray));
+		HBRUSH gradBrush = CachedBrush(RGB(gray, gray, gray));
 		SelectObject(hdc, gradBrush);
 		Ellipse(hdc, x - radius + i*2, y - radius + i*2, x + radius - i*2, y + radius - i*2);
-		DeleteObject(gradBrush);
 	}
 
 	// Inner dial surface
-	HBRUSH dialBrush = CreateSolidBrush(RGB(160, 160, 160));
+	HBRUSH dialBrush = CachedBrush(RGB(160, 160, 160));
 	SelectObject(hdc, dialBrush);
 	Ellipse(hdc, x - radius + 8, y - radius + 8, x + radius - 8, y + radius - 8);
-	DeleteObject(dialBrush);
 
 	// Outer ring
-	HPEN ringPen = CreatePen(PS_SOLID, 2, RGB(48, 48, 48));
+	HPEN ringPen = CachedPen(2, RGB(48, 48, 48));
 	SelectObject(hdc, ringPen);
 	Ellipse(hdc, x - radius, y - radius, x + radius, y + radius);
-	DeleteObject(ringPen);
 
 	// Tick marks with better contrast
-	HPEN tickPen = CreatePen(PS_SOLID, 2, RGB(0, 0, 0));
+	HPEN tickPen = CachedPen(2, RGB(0, 0, 0));
 	SelectObject(hdc, tickPen);
 
 	// Draw major tick marks and frequency labels
 	SetTextColor(hdc, RGB(0, 0, 0));
 	SetBkMode(hdc, TRANSPARENT);
-	HFONT smallFont = CreateFont(9, 0, 0, 0, FW_BOLD, FALSE, FALSE, FALSE,
-								DEFAULT_CHARSET, OUT_DEFAULT_PRECIS,
-								CLIP_DEFAULT_PRECIS, DEFAULT_QUALITY,
-								DEFAULT_PITCH | FF_SWISS, "Tahoma");
+	HFONT smallFont = CachedFont(9, DEFAULT_PITCH | FF_SWISS, "Tahoma");
 	SelectObject(hdc, smallFont);
 	SetTextAlign(hdc, TA_CENTER);
 
@@ -702,8 +1916,6 @@ void DrawTuningDial(HDC hdc, int x, int y, int radius, float frequency) {
 		LineTo(hdc, tickEndX, tickEndY);
 	}
 
-	DeleteObject(tickPen);
-
 	// Simplified pointer
 	float normalizedFreq = (frequency - 10.0f) / 24.0f;
 	float angle = -3.14159f * 0.75f + normalizedFreq * (3.14159f * 1.5f);
@@ -711,53 +1923,42 @@ void DrawTuningDial(HDC hdc, int x, int y, int radius, float frequency) {
 	int pointerY = y + (int)((radius - 15) * sin(angle));
 
 	// Main pointer
-	HPEN pointerPen = CreatePen(PS_SOLID, 3, RGB(255, 64, 64));
+	HPEN pointerPen = CachedPen(3, RGB(255, 64, 64));
 	SelectObject(hdc, pointerPen);
 	MoveToEx(hdc, x, y, NULL);
 	LineTo(hdc, pointerX, pointerY);
-	DeleteObject(pointerPen);
 
 	// Center dot
-	HBRUSH centerBrush = CreateSolidBrush(RGB(64, 64, 64));
+	HBRUSH centerBrush = CachedBrush(RGB(64, 64, 64));
 	SelectObject(hdc, centerBrush);
 	Ellipse(hdc, x - 4, y - 4, x + 4, y + 4);
-	DeleteObject(centerBrush);
-
-	DeleteObject(smallFont);
 
 	// Label with Winamp style
 	SetTextColor(hdc, RGB(192, 192, 192));
-	HFONT labelFont = CreateFont(12, 0, 0, 0, FW_BOLD, FALSE, FALSE, FALSE,
-							   DEFAULT_CHARSET, OUT_DEFAULT_PRECIS,
-							   CLIP_DEFAULT_PRECIS, DEFAULT_QUALITY,
-							   DEFAULT_PITCH | FF_SWISS, "Tahoma");
+	HFONT labelFont = CachedFont(12, DEFAULT_PITCH | FF_SWISS, "Tahoma");
 	SelectObject(hdc, labelFont);
 	SetTextAlign(hdc, TA_CENTER);
 	TextOut(hdc, x, y + radius + 15, "TUNING", 6);
-	DeleteObject(labelFont);
 }
 
 void DrawVolumeKnob(HDC hdc, int x, int y, int radius, float volume) {
 	// Simplified chrome gradient knob
 	for (int i = 0; i < 3; i++) {
 		int gray = 100 + i * 30;
-		HBRUSH gradBrush = CreateSolidBrush(RGB(gray, gray, gray));
+		HBRUSH gradBrush = CachedBrush(RGB(gray, gray, gray));
 		SelectObject(hdc, gradBrush);
 		Ellipse(hdc, x - radius + i*2, y - radius + i*2, x + radius - i*2, y + radius - i*2);
-		DeleteObject(gradBrush);
 	}
 
 	// Inner knob surface
-	HBRUSH knobBrush = CreateSolidBrush(RGB(180, 180, 180));
+	HBRUSH knobBrush = CachedBrush(RGB(180, 180, 180));
 	SelectObject(hdc, knobBrush);
 	Ellipse(hdc, x - radius + 6, y - radius + 6, x + radius - 6, y + radius - 6);
-	DeleteObject(knobBrush);
 
 	// Outer ring
-	HPEN ringPen = CreatePen(PS_SOLID, 1, RGB(64, 64, 64));
+	HPEN ringPen = CachedPen(1, RGB(64, 64, 64));
 	SelectObject(hdc, ringPen);
 	Ellipse(hdc, x - radius, y - radius, x + radius, y + radius);
-	DeleteObject(ringPen);
 
 	// Volume indicator
 	float angle = volume * 3.14159f * 1.5f - 3.14159f * 0.75f;
@@ -765,29 +1966,23 @@ void DrawVolumeKnob(HDC hdc, int x, int y, int radius, float volume) {
 	int indicatorY = y + (int)((radius - 8) * sin(angle));
 
 	// Main indicator
-	HPEN indicatorPen = CreatePen(PS_SOLID, 2, RGB(255, 255, 255));
+	HPEN indicatorPen = CachedPen(2, RGB(255, 255, 255));
 	SelectObject(hdc, indicatorPen);
 	MoveToEx(hdc, x, y, NULL);
 	LineTo(hdc, indicatorX, indicatorY);
-	DeleteObject(indicatorPen);
 
 	// Center dot
-	HBRUSH centerBrush = CreateSolidBrush(RGB(64, 64, 64));
+	HBRUSH centerBrush = CachedBrush(RGB(64, 64, 64));
 	SelectObject(hdc, centerBrush);
 	Ellipse(hdc, x - 3, y - 3, x + 3, y + 3);
-	DeleteObject(centerBrush);
 
 	// Label
 	SetBkMode(hdc, TRANSPARENT);
 	SetTextColor(hdc, RGB(192, 192, 192));
-	HFONT labelFont = CreateFont(12, 0, 0, 0, FW_BOLD, FALSE, FALSE, FALSE,
-							   DEFAULT_CHARSET, OUT_DEFAULT_PRECIS,
-							   CLIP_DEFAULT_PRECIS, DEFAULT_QUALITY,
-							   DEFAULT_PITCH | FF_SWISS, "Tahoma");
+	HFONT labelFont = CachedFont(12, DEFAULT_PITCH | FF_SWISS, "Tahoma");
 	SelectObject(hdc, labelFont);
 	SetTextAlign(hdc, TA_CENTER);
 	TextOut(hdc, x, y + radius + 15, "VOLUME", 6);
-	DeleteObject(labelFont);
 }
 
 void DrawSignalMeter(HDC hdc, int x, int y, int strength) {
@@ -795,13 +1990,12 @@ void DrawSignalMeter(HDC hdc, int x, int y, int strength) {
 	RECT meter = {x, y, x + 80, y + 20};
 
 	// Dark background
-	HBRUSH meterBrush = CreateSolidBrush(RGB(16, 16, 16));
+	HBRUSH meterBrush = CachedBrush(RGB(16, 16, 16));
 	FillRect(hdc, &meter, meterBrush);
-	DeleteObject(meterBrush);
 
 	// Beveled border
-	HPEN lightPen = CreatePen(PS_SOLID, 1, RGB(64, 64, 64));
-	HPEN darkPen = CreatePen(PS_SOLID, 1, RGB(0, 0, 0));
+	HPEN lightPen = CachedPen(1, RGB(64, 64, 64));
+	HPEN darkPen = CachedPen(1, RGB(0, 0, 0));
 
 	SelectObject(hdc, darkPen);
 	MoveToEx(hdc, meter.left, meter.bottom, NULL);
@@ -812,9 +2006,6 @@ void DrawSignalMeter(HDC hdc, int x, int y, int strength) {
 	LineTo(hdc, meter.right, meter.bottom);
 	LineTo(hdc, meter.left, meter.bottom);
 
-	DeleteObject(lightPen);
-	DeleteObject(darkPen);
-
 	// Neon-style signal bars
 	int barWidth = 7;
 	int numBars = strength / 10;
@@ -827,9 +2018,8 @@ void DrawSignalMeter(HDC hdc, int x, int y, int strength) {
 		else if (i < 7) barColor = RGB(255, 255, 0);  // Yellow
 		else barColor = RGB(255, 64, 64);             // Bright red
 
-		HBRUSH barBrush = CreateSolidBrush(barColor);
+		HBRUSH barBrush = CachedBrush(barColor);
 		FillRect(hdc, &bar, barBrush);
-		DeleteObject(barBrush);
 
 		// Add glow effect
 		COLORREF glowColor;
@@ -837,37 +2027,32 @@ void DrawSignalMeter(HDC hdc, int x, int y, int strength) {
 		else if (i < 7) glowColor = RGB(128, 128, 0);
 		else glowColor = RGB(128, 32, 32);
 
-		HPEN glowPen = CreatePen(PS_SOLID, 1, glowColor);
+		HPEN glowPen = CachedPen(1, glowColor);
 		SelectObject(hdc, glowPen);
 		Rectangle(hdc, bar.left - 1, bar.top - 1, bar.right + 1, bar.bottom + 1);
-		DeleteObject(glowPen);
 	}
 
 	// Label
 	SetBkMode(hdc, TRANSPARENT);
 	SetTextColor(hdc, RGB(192, 192, 192));
-	HFONT labelFont = CreateFont(11, 0, 0, 0, FW_BOLD, FALSE, FALSE, FALSE,
-							   DEFAULT_CHARSET, OUT_DEFAULT_PRECIS,
-							   CLIP_DEFAULT_PRECIS, DEFAULT_QUALITY,
-							   DEFAULT_PITCH | FF_SWISS, "Tahoma");
+	HFONT labelFont = CachedFont(11, DEFAULT_PITCH | FF_SWISS, "Tahoma");
 	SelectObject(hdc, labelFont);
 	SetTextAlign(hdc, TA_LEFT);
 	TextOut(hdc, x, y - 16, "SIGNAL", 6);
-	DeleteObject(labelFont);
 }
 
-void DrawVUMeter(HDC hdc, int x, int y, float leftLevel, float rightLevel) {
+void DrawVUMeter(HDC hdc, int x, int y, float leftLevel, float rightLevel,
+				 float leftPeak, float rightPeak) {
 	// Winamp-style VU meter with classic look
 	RECT meterBg = {x, y, x + 80, y + 40};
 
 	// Dark background
-	HBRUSH bgBrush = CreateSolidBrush(RGB(16, 16, 16));
+	HBRUSH bgBrush = CachedBrush(RGB(16, 16, 16));
 	FillRect(hdc, &meterBg, bgBrush);
-	DeleteObject(bgBrush);
 
 	// Beveled border
-	HPEN lightPen = CreatePen(PS_SOLID, 1, RGB(64, 64, 64));
-	HPEN darkPen = CreatePen(PS_SOLID, 1, RGB(0, 0, 0));
+	HPEN lightPen = CachedPen(1, RGB(64, 64, 64));
+	HPEN darkPen = CachedPen(1, RGB(0, 0, 0));
 
 	SelectObject(hdc, darkPen);
 	MoveToEx(hdc, meterBg.left, meterBg.bottom, NULL);
@@ -878,16 +2063,10 @@ void DrawVUMeter(HDC hdc, int x, int y, float leftLevel, float rightLevel) {
 	LineTo(hdc, meterBg.right, meterBg.bottom);
 	LineTo(hdc, meterBg.left, meterBg.bottom);
 
-	DeleteObject(lightPen);
-	DeleteObject(darkPen);
-
 	// "VU" label with classic styling
 	SetTextColor(hdc, RGB(0, 255, 0));
 	SetBkMode(hdc, TRANSPARENT);
-	HFONT vuFont = CreateFont(10, 0, 0, 0, FW_BOLD, FALSE, FALSE, FALSE,
-							 DEFAULT_CHARSET, OUT_DEFAULT_PRECIS,
-							 CLIP_DEFAULT_PRECIS, DEFAULT_QUALITY,
-							 DEFAULT_PITCH | FF_SWISS, "Tahoma");
+	HFONT vuFont = CachedFont(10, DEFAULT_PITCH | FF_SWISS, "Tahoma");
 	SelectObject(hdc, vuFont);
 	TextOut(hdc, x + 5, y + 2, "VU", 2);
 
@@ -902,9 +2081,8 @@ void DrawVUMeter(HDC hdc, int x, int y, float leftLevel, float rightLevel) {
 		else if (leftLevel > 0.6f) leftColor = RGB(255, 255, 0); // Yellow
 		else leftColor = RGB(0, 255, 64);                        // Green
 
-		HBRUSH leftBrush = CreateSolidBrush(leftColor);
+		HBRUSH leftBrush = CachedBrush(leftColor);
 		FillRect(hdc, &leftBar, leftBrush);
-		DeleteObject(leftBrush);
 
 		// Add glow effect
 		COLORREF glowColor;
@@ -912,10 +2090,9 @@ void DrawVUMeter(HDC hdc, int x, int y, float leftLevel, float rightLevel) {
 		else if (leftLevel > 0.6f) glowColor = RGB(128, 128, 0);
 		else glowColor = RGB(0, 128, 32);
 
-		HPEN glowPen = CreatePen(PS_SOLID, 1, glowColor);
+		HPEN glowPen = CachedPen(1, glowColor);
 		SelectObject(hdc, glowPen);
 		Rectangle(hdc, leftBar.left - 1, leftBar.top - 1, leftBar.right + 1, leftBar.bottom + 1);
-		DeleteObject(glowPen);
 	}
 
 	// Right channel meter with neon effect
@@ -929,9 +2106,8 @@ void DrawVUMeter(HDC hdc, int x, int y, float leftLevel, float rightLevel) {
 		else if (rightLevel > 0.6f) rightColor = RGB(255, 255, 0); // Yellow
 		else rightColor = RGB(0, 255, 64);                         // Green
 
-		HBRUSH rightBrush = CreateSolidBrush(rightColor);
+		HBRUSH rightBrush = CachedBrush(rightColor);
 		FillRect(hdc, &rightBar, rightBrush);
-		DeleteObject(rightBrush);
 
 		// Add glow effect
 		COLORREF glowColor;
@@ -939,10 +2115,23 @@ void DrawVUMeter(HDC hdc, int x, int y, float leftLevel, float rightLevel) {
 		else if (rightLevel > 0.6f) glowColor = RGB(128, 128, 0);
 		else glowColor = RGB(0, 128, 32);
 
-		HPEN glowPen = CreatePen(PS_SOLID, 1, glowColor);
+		HPEN glowPen = CachedPen(1, glowColor);
 		SelectObject(hdc, glowPen);
 		Rectangle(hdc, rightBar.left - 1, rightBar.top - 1, rightBar.right + 1, rightBar.bottom + 1);
-		DeleteObject(glowPen);
+	}
+
+	// Peak hold markers
+	HBRUSH peakBrush = CachedBrush(RGB(224, 224, 224));
+	int leftPeakX = (int)(leftPeak * 65);
+	if (leftPeakX > 0) {
+		RECT leftMark = {x + 7 + leftPeakX, y + 11, x + 9 + leftPeakX, y + 18};
+		FillRect(hdc, &leftMark, peakBrush);
+	}
+	int rightPeakX = (int)(rightPeak * 65);
+	if (rightPeakX > 0) {
+		RECT rightMark = {x + 7 + rightPeakX, y + 21,
+						  x + 9 + rightPeakX, y + 28};
+		FillRect(hdc, &rightMark, peakBrush);
 	}
 
 	// Channel labels
@@ -951,15 +2140,39 @@ void DrawVUMeter(HDC hdc, int x, int y, float leftLevel, float rightLevel) {
 	TextOut(hdc, x + 75, y + 22, "R", 1);
 
 	// Scale marks
-	HPEN scalePen = CreatePen(PS_SOLID, 1, RGB(64, 64, 64));
+	HPEN scalePen = CachedPen(1, RGB(64, 64, 64));
 	SelectObject(hdc, scalePen);
 	for (int i = 1; i < 10; i++) {
 		int markX = x + 8 + (i * 7);
 		MoveToEx(hdc, markX, y + 30, NULL);
 		LineTo(hdc, markX, y + 32);
 	}
-	DeleteObject(scalePen);
-	DeleteObject(vuFont);
+}
+
+void DrawBandScope(HDC hdc, int x, int y) {
+	RECT frame = {x - 2, y - 2, x + SCOPE_WIDTH + 2, y + SCOPE_HEIGHT + 2};
+
+	// Beveled border
+	HPEN lightPen = CachedPen(1, RGB(64, 64, 64));
+	HPEN darkPen = CachedPen(1, RGB(0, 0, 0));
+
+	SelectObject(hdc, darkPen);
+	MoveToEx(hdc, frame.left, frame.bottom, NULL);
+	LineTo(hdc, frame.left, frame.top);
+	LineTo(hdc, frame.right, frame.top);
+
+	SelectObject(hdc, lightPen);
+	LineTo(hdc, frame.right, frame.bottom);
+	LineTo(hdc, frame.left, frame.bottom);
+
+	// Panel contents are already rendered; blank it while powered off
+	if (g_radio.power && InitBandScope()) {
+		BitBlt(hdc, x, y, SCOPE_WIDTH, SCOPE_HEIGHT, g_scope.dc, 0, 0, SRCCOPY);
+	} else {
+		RECT inner = {x, y, x + SCOPE_WIDTH, y + SCOPE_HEIGHT};
+		HBRUSH blackBrush = CachedBrush(RGB(0, 0, 0));
+		FillRect(hdc, &inner, blackBrush);
+	}
 }
 
 void DrawPowerButton(HDC hdc, int x, int y, int radius, int power) {
@@ -967,55 +2180,188 @@ void DrawPowerButton(HDC hdc, int x, int y, int radius, int power) {
 	for (int i = 0; i < 3; i++) {
 		int intensity = power ? (80 + i * 40) : (60 + i * 20);
 		COLORREF buttonColor = power ? RGB(255 - i * 40, intensity, intensity) : RGB(intensity, intensity, intensity);
-		HBRUSH buttonBrush = CreateSolidBrush(buttonColor);
+		HBRUSH buttonBrush = CachedBrush(buttonColor);
 		SelectObject(hdc, buttonBrush);
 		Ellipse(hdc, x - radius + i*2, y - radius + i*2, x + radius - i*2, y + radius - i*2);
-		DeleteObject(buttonBrush);
 	}
 
 	// Inner button surface
 	COLORREF innerColor = power ? RGB(255, 128, 128) : RGB(128, 128, 128);
-	HBRUSH innerBrush = CreateSolidBrush(innerColor);
+	HBRUSH innerBrush = CachedBrush(innerColor);
 	SelectObject(hdc, innerBrush);
 	Ellipse(hdc, x - radius + 6, y - radius + 6, x + radius - 6, y + radius - 6);
-	DeleteObject(innerBrush);
 
 	// Button border
-	HPEN borderPen = CreatePen(PS_SOLID, 2, RGB(32, 32, 32));
+	HPEN borderPen = CachedPen(2, RGB(32, 32, 32));
 	SelectObject(hdc, borderPen);
 	Ellipse(hdc, x - radius, y - radius, x + radius, y + radius);
-	DeleteObject(borderPen);
 
 	// Power symbol
 	if (power) {
 		// Main symbol
-		HPEN symbolPen = CreatePen(PS_SOLID, 3, RGB(255, 255, 255));
+		HPEN symbolPen = CachedPen(3, RGB(255, 255, 255));
 		SelectObject(hdc, symbolPen);
 		Arc(hdc, x - 8, y - 8, x + 8, y + 8, x + 6, y - 6, x - 6, y - 6);
 		MoveToEx(hdc, x, y - 10, NULL);
 		LineTo(hdc, x, y - 2);
-		DeleteObject(symbolPen);
 	} else {
 		// Dim power symbol
-		HPEN symbolPen = CreatePen(PS_SOLID, 2, RGB(64, 64, 64));
+		HPEN symbolPen = CachedPen(2, RGB(64, 64, 64));
 		SelectObject(hdc, symbolPen);
 		Arc(hdc, x - 8, y - 8, x + 8, y + 8, x + 6, y - 6, x - 6, y - 6);
 		MoveToEx(hdc, x, y - 10, NULL);
 		LineTo(hdc, x, y - 2);
-		DeleteObject(symbolPen);
 	}
 
 	// Label
 	SetBkMode(hdc, TRANSPARENT);
 	SetTextColor(hdc, power ? RGB(255, 192, 192) : RGB(192, 192, 192));
-	HFONT labelFont = CreateFont(12, 0, 0, 0, FW_BOLD, FALSE, FALSE, FALSE,
-							   DEFAULT_CHARSET, OUT_DEFAULT_PRECIS,
-							   CLIP_DEFAULT_PRECIS, DEFAULT_QUALITY,
-							   DEFAULT_PITCH | FF_SWISS, "Tahoma");
+	HFONT labelFont = CachedFont(12, DEFAULT_PITCH | FF_SWISS, "Tahoma");
 	SelectObject(hdc, labelFont);
 	SetTextAlign(hdc, TA_CENTER);
 	TextOut(hdc, x, y - radius - 18, "POWER", 5);
-	DeleteObject(labelFont);
+}
+
+void InitGdiCache() {
+	// Every style the Draw functions ask for, including each step of
+	// their gradients and meter colours
+	static const COLORREF brushes[] = {
+		RGB(24, 24, 24), RGB(32, 32, 32), RGB(16, 16, 16), RGB(0, 0, 0),
+		RGB(45, 45, 45), RGB(48, 48, 48), RGB(51, 51, 51), RGB(54, 54, 54),
+		RGB(57, 57, 57), RGB(60, 60, 60), RGB(63, 63, 63), RGB(66, 66, 66),
+		RGB(80, 80, 80), RGB(100, 100, 100), RGB(120, 120, 120),
+		RGB(140, 140, 140), RGB(160, 160, 160), RGB(130, 130, 130),
+		RGB(180, 180, 180), RGB(64, 64, 64),
+		RGB(0, 255, 64), RGB(255, 255, 0), RGB(255, 64, 64), RGB(224, 224, 224),
+		RGB(255, 80, 80), RGB(215, 120, 120), RGB(175, 160, 160),
+		RGB(255, 128, 128), RGB(128, 128, 128),
+	};
+	static const struct {
+		int width;
+		COLORREF color;
+	} pens[] = {
+		{1, RGB(128, 128, 128)}, {1, RGB(16, 16, 16)}, {1, RGB(64, 64, 64)},
+		{1, RGB(0, 0, 0)}, {1, RGB(0, 128, 32)}, {1, RGB(128, 128, 0)},
+		{1, RGB(128, 32, 32)},
+		{2, RGB(96, 96, 96)}, {2, RGB(32, 32, 32)}, {2, RGB(48, 48, 48)},
+		{2, RGB(0, 0, 0)}, {2, RGB(255, 255, 255)}, {2, RGB(64, 64, 64)},
+		{3, RGB(255, 64, 64)}, {3, RGB(255, 255, 255)},
+	};
+
+	for (int i = 0; i < (int)(sizeof(brushes) / sizeof(brushes[0])); i++) {
+		CachedBrush(brushes[i]);
+	}
+	for (int i = 0; i < (int)(sizeof(pens) / sizeof(pens[0])); i++) {
+		CachedPen(pens[i].width, pens[i].color);
+	}
+	for (int height = 9; height <= 12; height++) {
+		CachedFont(height, DEFAULT_PITCH | FF_SWISS, "Tahoma");
+	}
+	CachedFont(14, DEFAULT_PITCH | FF_MODERN, "Tahoma");
+	CachedFont(20, FIXED_PITCH | FF_MODERN, "Consolas");
+	g_gdi.misses = 0;
+}
+
+void CleanupGdiCache() {
+	// Only called once nothing is painting, so none are still selected
+	for (int i = 0; i < GDI_CACHE_SIZE; i++) {
+		if (g_gdi.entries[i].object) DeleteObject(g_gdi.entries[i].object);
+		g_gdi.entries[i].key = 0;
+		g_gdi.entries[i].object = NULL;
+	}
+	for (int i = 0; i < g_gdi.fontCount; i++) {
+		DeleteObject(g_gdi.fonts[i].font);
+	}
+	g_gdi.count = 0;
+	g_gdi.fontCount = 0;
+}
+
+HPEN CachedPen(int width, COLORREF color) {
+	DWORD key = ((DWORD)(1 + width) << 24) | color;
+	return (HPEN)GdiCacheObject(key, width, color);
+}
+
+HBRUSH CachedBrush(COLORREF color) {
+	return (HBRUSH)GdiCacheObject(((DWORD)1 << 24) | color, 0, color);
+}
+
+HFONT CachedFont(int height, DWORD pitchAndFamily, const char* face) {
+	if (g_gdi.uncached) {
+		HFONT font = CreateFont(height, 0, 0, 0, FW_BOLD, FALSE, FALSE, FALSE,
+								DEFAULT_CHARSET, OUT_DEFAULT_PRECIS,
+								CLIP_DEFAULT_PRECIS, DEFAULT_QUALITY,
+								pitchAndFamily, face);
+		return (HFONT)GdiCacheTransient(font);
+	}
+
+	// A handful of fonts; a scan is plenty
+	for (int i = 0; i < g_gdi.fontCount; i++) {
+		GdiFont* font = &g_gdi.fonts[i];
+		if (font->height == height && font->pitchAndFamily == pitchAndFamily &&
+			strcmp(font->face, face) == 0) {
+			return font->font;
+		}
+	}
+
+	if (g_gdi.fontCount >= GDI_FONTS) return (HFONT)GetStockObject(SYSTEM_FONT);
+	GdiFont* font = &g_gdi.fonts[g_gdi.fontCount];
+	font->font = CreateFont(height, 0, 0, 0, FW_BOLD, FALSE, FALSE, FALSE,
+							DEFAULT_CHARSET, OUT_DEFAULT_PRECIS,
+							CLIP_DEFAULT_PRECIS, DEFAULT_QUALITY,
+							pitchAndFamily, face);
+	if (!font->font) return (HFONT)GetStockObject(SYSTEM_FONT);
+	font->height = height;
+	font->pitchAndFamily = pitchAndFamily;
+	font->face = face;
+	g_gdi.fontCount++;
+	g_gdi.misses++;
+	return font->font;
+}
+
+HGDIOBJ GdiCacheObject(DWORD key, int width, COLORREF color) {
+	if (g_gdi.uncached) {
+		HGDIOBJ object = width ? (HGDIOBJ)CreatePen(PS_SOLID, width, color)
+							   : (HGDIOBJ)CreateSolidBrush(color);
+		return GdiCacheTransient(object);
+	}
+
+	// Open addressing on a multiplicative hash of the style
+	DWORD hash = (key * 2654435761u) >> 25;
+	for (int probe = 0; probe < GDI_CACHE_SIZE; probe++) {
+		GdiEntry* entry = &g_gdi.entries[(hash + probe) % GDI_CACHE_SIZE];
+		if (entry->key == key) return entry->object;
+		if (entry->key != 0) continue;
+
+		// Not seen before: keep it, unless the table is getting full
+		if (g_gdi.count >= GDI_CACHE_SIZE / 2) break;
+		HGDIOBJ object = width ? (HGDIOBJ)CreatePen(PS_SOLID, width, color)
+							   : (HGDIOBJ)CreateSolidBrush(color);
+		if (!object) break;
+		entry->key = key;
+		entry->object = object;
+		g_gdi.count++;
+		g_gdi.misses++;
+		return object;
+	}
+	return GetStockObject(width ? BLACK_PEN : BLACK_BRUSH);
+}
+
+HGDIOBJ GdiCacheTransient(HGDIOBJ object) {
+	if (g_gdi.transientCount < GDI_TRANSIENT_MAX) {
+		g_gdi.transient[g_gdi.transientCount++] = object;
+	}
+	return object;
+}
+
+void GdiReleaseTransient(HDC hdc) {
+	// Deselect first: GDI won't delete an object a DC still holds
+	SelectObject(hdc, GetStockObject(BLACK_PEN));
+	SelectObject(hdc, GetStockObject(WHITE_BRUSH));
+	SelectObject(hdc, GetStockObject(SYSTEM_FONT));
+	for (int i = 0; i < g_gdi.transientCount; i++) {
+		DeleteObject(g_gdi.transient[i]);
+	}
+	g_gdi.transientCount = 0;
 }
 
 int IsPointInCircle(int px, int py, int cx, int cy, int radius) {
@@ -1046,23 +2392,15 @@ void UpdateFrequencyFromMouse(int mouseX, int mouseY) {
 	if (g_radio.frequency < 10.0f) g_radio.frequency = 10.0f;
 	if (g_radio.frequency > 34.0f) g_radio.frequency = 34.0f;
 
-	// Calculate signal strength based on nearest station
-	RadioStation* nearestStation = FindNearestStation(g_radio.frequency);
-	if (nearestStation) {
-		g_radio.signalStrength = (int)(GetStationSignalStrength(nearestStation, g_radio.frequency) * 100.0f);
-
-		// Start streaming if signal is strong enough and station changed
-		if (g_radio.signalStrength > 50 && nearestStation != g_audio.currentStation) {
-			StopBassStreaming();
-			StartBassStreaming(nearestStation);
-		}
-	} else {
-		g_radio.signalStrength = 5 + (int)(15.0f * sin(g_radio.frequency));
-		StopBassStreaming();
-	}
+	OnFrequencyChanged();
+}
 
-	if (g_radio.signalStrength < 0) g_radio.signalStrength = 0;
-	if (g_radio.signalStrength > 100) g_radio.signalStrength = 100;
+void OnFrequencyChanged() {
+	// Signal strength follows the dial at once; whether to connect or
+	// drop the station is left to the tuner's thresholds and timers
+	UpdateSignalStrength();
+	TunerUpdate();
+	PrefetchUpdate(g_radio.frequency);
 
 	UpdateStaticVolume(g_radio.signalStrength);
 	UpdateStreamVolume();
@@ -1088,60 +2426,95 @@ void UpdateVolumeFromMouse(int mouseX, int mouseY) {
 
 int InitializeAudio() {
 	// Initialize BASS with more detailed error reporting
-	printf("Initializing BASS audio system...\n");
+	Log("Initializing BASS audio system...\n");
 
-	if (!BASS_Init(-1, 44100, 0, 0, NULL)) {
+	if (!BASS_Init(-1, SAMPLE_RATE, 0, 0, NULL)) {
 		DWORD error = BASS_ErrorGetCode();
-		printf("BASS initialization failed (Error: %lu)\n", error);
+		Log("BASS initialization failed (Error: %lu)\n", error);
 
 		// Try alternative initialization methods
-		printf("Trying alternative audio device...\n");
-		if (!BASS_Init(0, 44100, 0, 0, NULL)) {
+		Log("Trying alternative audio device...\n");
+		if (!BASS_Init(0, SAMPLE_RATE, 0, 0, NULL)) {
 			error = BASS_ErrorGetCode();
-			printf("Alternative BASS init also failed (Error: %lu)\n", error);
-			printf("BASS Error meanings:\n");
-			printf("  1 = BASS_ERROR_MEM (memory error)\n");
-			printf("  2 = BASS_ERROR_FILEOPEN (file/URL error)\n");
-			printf("  3 = BASS_ERROR_DRIVER (no audio driver)\n");
-			printf("  8 = BASS_ERROR_ALREADY (already initialized)\n");
-			printf("  14 = BASS_ERROR_DEVICE (invalid device)\n");
+			Log("Alternative BASS init also failed (Error: %lu)\n", error);
+			Log("BASS Error meanings:\n");
+			Log("  1 = BASS_ERROR_MEM (memory error)\n");
+			Log("  2 = BASS_ERROR_FILEOPEN (file/URL error)\n");
+			Log("  3 = BASS_ERROR_DRIVER (no audio driver)\n");
+			Log("  8 = BASS_ERROR_ALREADY (already initialized)\n");
+			Log("  14 = BASS_ERROR_DEVICE (invalid device)\n");
 			return -1;
 		}
 	}
 
-	printf("BASS initialized successfully\n");
+	Log("BASS initialized successfully\n");
+
+	// Every open shares these; see the adaptive buffering notes
+	BASS_SetConfig(BASS_CONFIG_NET_BUFFER, BUFFER_NET_MS);
+	BASS_SetConfig(BASS_CONFIG_NET_PREBUF, BUFFER_NET_PREBUF);
+
+	// Render at whatever rate the device actually runs, so BASS only
+	// converts our float output once instead of resampling it too.
+	// Vista and later report the shared mixer's rate here; on XP the
+	// DirectSound primary buffer is set to the rate we asked for, so this
+	// reads back SAMPLE_RATE and the kernel mixer still resamples after us
+	BASS_INFO info;
+	if (BASS_GetInfo(&info) && info.freq) {
+		g_sampleRate = info.freq;
+	}
+	Log("Output rate: %lu Hz (float)\n", g_sampleRate);
+
+	SmoothedParamInit(&g_mixer.stationGain, MIXER_SMOOTH_MODE,
+					  MIXER_SMOOTH_TIME, (float)g_sampleRate, 0.0f);
+	SmoothedParamInit(&g_mixer.staticGain, MIXER_SMOOTH_MODE,
+					  MIXER_SMOOTH_TIME, (float)g_sampleRate, 0.0f);
+
+	// Timeshift is optional; without the temp file the radio just stays live
+	if (TimeshiftOpen(&g_timeshift, TIMESHIFT_SECONDS, g_sampleRate)) {
+		TimeshiftStartWriter(&g_timeshift);
+	}
 
 	// Get BASS version info
 	DWORD version = BASS_GetVersion();
-	printf("BASS version: %d.%d.%d.%d\n",
+	Log("BASS version: %d.%d.%d.%d\n",
 		   HIBYTE(HIWORD(version)), LOBYTE(HIWORD(version)),
 		   HIBYTE(LOWORD(version)), LOBYTE(LOWORD(version)));
 
 	g_audio.currentStream = 0;
-	g_audio.staticStream = 0;
+	g_audio.outputStream = 0;
 	g_audio.isPlaying = 0;
 	g_audio.staticVolume = 0.8f;
 	g_audio.radioVolume = 0.0f;
 	g_audio.currentStation = NULL;
 	g_audio.vuLevelLeft = 0.0f;
 	g_audio.vuLevelRight = 0.0f;
+	g_audio.vuPeakLeft = 0.0f;
+	g_audio.vuPeakRight = 0.0f;
+
+	// Pick the noise fill routine once for this CPU
+	g_noiseFill = SelectNoiseFill();
+	g_ifFilterRun = SelectIfFilter();
+	InitSineTable();
+	InitPropagationTables();
 
 	return 0;
 }
 
 void CleanupAudio() {
 	StopBassStreaming();
+	TimeshiftClose(&g_timeshift);
 
 	// Free BASS
 	BASS_Free();
-	printf("BASS cleaned up\n");
+	Log("BASS cleaned up\n");
 }
 
 void StartAudio() {
 	if (!g_audio.isPlaying) {
 		g_audio.isPlaying = 1;
+		StartMixer();
 		StartStaticNoise();
-		printf("Audio started with static\n");
+		Log("Audio started with static\n");
 	}
 }
 
@@ -1150,250 +2523,5046 @@ void StopAudio() {
 		g_audio.isPlaying = 0;
 		StopBassStreaming();
 		StopStaticNoise();
-		printf("Audio stopped\n");
+		StopMixer();
+		Log("Audio stopped\n");
 	}
 }
 
 RadioStation* FindNearestStation(float frequency) {
-	RadioStation* nearest = NULL;
-	float minDistance = 999.0f;
-
-	for (int i = 0; i < NUM_STATIONS; i++) {
-		float distance = fabs(g_stations[i].frequency - frequency);
-		if (distance < minDistance) {
-			minDistance = distance;
-			nearest = &g_stations[i];
-		}
-	}
+	int nearest = StationIndexNearest(&g_stationIndex, frequency);
+	if (nearest < 0) return NULL;
 
 	// Only return station if we're close enough (within 0.5 MHz)
-	if (minDistance <= 0.5f) {
-		return nearest;
+	if (fabs(g_stationKeys[nearest] - frequency) <= 0.5f) {
+		return &g_stations[nearest];
 	}
 
 	return NULL;
 }
 
-float GetStationSignalStrength(RadioStation* station, float currentFreq) {
-	if (!station) return 0.0f;
-
-	float distance = fabs(station->frequency - currentFreq);
+int GetAppFilePath(const char* name, char* path) {
+	// Files the radio keeps live beside the executable
+	DWORD length = GetModuleFileName(NULL, path, MAX_PATH);
+	char* slash = length && length < MAX_PATH ? strrchr(path, '\\') : NULL;
+	if (!slash || (slash + 1 - path) + strlen(name) >= MAX_PATH) return 0;
 
-	// Signal strength drops off with distance from exact frequency
-	if (distance < 0.05f) {
-		return 0.9f; // Very strong signal
-	} else if (distance < 0.1f) {
-		return 0.7f; // Strong signal
-	} else if (distance < 0.2f) {
-		return 0.5f; // Medium signal
-	} else if (distance < 0.5f) {
-		return 0.2f; // Weak signal
-	}
+	strcpy(slash + 1, name);
+	return 1;
+}
 
-	return 0.0f; // No signal
+int CompareStations(const void* a, const void* b) {
+	float fa = ((const RadioStation*)a)->frequency;
+	float fb = ((const RadioStation*)b)->frequency;
+	return fa < fb ? -1 : fa > fb ? 1 : 0;
 }
 
-int StartBassStreaming(RadioStation* station) {
-	if (!station) {
-		printf("StartBassStreaming failed: no station\n");
-		return 0;
-	}
+int LoadStationDirectory() {
+	char path[MAX_PATH];
+	g_stationCount = 0;
+	g_stationStringsUsed = 0;
 
-	StopBassStreaming();
+	// stations.txt beside the executable replaces the built-in stations
+	if (GetAppFilePath(STATION_FILE, path)) {
+		LoadStationFile(path);
+	}
 
-	printf("Attempting to stream: %s at %s\n", station->name, station->streamUrl);
+	if (g_stationCount == 0) {
+		for (int i = 0; i < NUM_BUILTIN_STATIONS; i++) {
+			g_stations[g_stationCount++] = g_builtinStations[i];
+		}
+	}
+
+	// Records are sorted once here and never move again, so pointers to
+	// them stay valid for the life of the program
+	qsort(g_stations, g_stationCount, sizeof(RadioStation), CompareStations);
+	for (int i = 0; i < g_stationCount; i++) {
+		g_stationKeys[i] = g_stations[i].frequency;
+	}
+	BuildStationIndex(&g_stationIndex, g_stationKeys, g_stationCount,
+					  g_stationBuckets, STATION_DIRECTORY_MAX);
+
+	Log("Station directory: %d stations, %d KB of strings\n", g_stationCount,
+		   g_stationStringsUsed / 1024);
+	return g_stationCount;
+}
+
+int LoadStationFile(const char* path) {
+	FILE* file = fopen(path, "r");
+	if (!file) return 0;
+
+	// One station per line, tab separated:
+	// frequency  power  name  description  stream URL
+	char line[1024];
+	int lineNumber = 0;
+	int loaded = 0;
+	while (fgets(line, sizeof(line), file)) {
+		lineNumber++;
+		char* fields[5];
+		int count = 0;
+		char* cursor = line;
+		line[strcspn(line, "\r\n")] = '\0';
+		if (line[0] == '#' || line[0] == '\0') continue;
+
+		while (count < 5) {
+			fields[count++] = cursor;
+			cursor = strchr(cursor, '\t');
+			if (!cursor) break;
+			*cursor++ = '\0';
+		}
+
+		float frequency = count == 5 ? (float)atof(fields[0]) : 0.0f;
+		float power = count == 5 ? (float)atof(fields[1]) : 0.0f;
+		if (frequency <= 0.0f || power <= 0.0f || power > 1.0f) {
+			Log("%s:%d: expected frequency, power (0-1], name, description "
+				"and URL\n", path, lineNumber);
+			continue;
+		}
+		if (!AddStation(frequency, power, fields[2], fields[3], fields[4])) {
+			Log("%s:%d: station directory full\n", path, lineNumber);
+			break;
+		}
+		loaded++;
+	}
+
+	fclose(file);
+	Log("Loaded %d stations from %s\n", loaded, path);
+	return loaded;
+}
+
+int AddStation(float frequency, float power, const char* name,
+			   const char* description, const char* streamUrl) {
+	if (g_stationCount >= STATION_DIRECTORY_MAX) return 0;
+
+	int mark = g_stationStringsUsed;
+	RadioStation* station = &g_stations[g_stationCount];
+	memset(station, 0, sizeof(RadioStation));
+	station->frequency = frequency;
+	station->power = power;
+	station->name = StoreStationString(name, STATION_NAME_MAX);
+	station->description = StoreStationString(description,
+											  STATION_DESCRIPTION_MAX);
+	station->streamUrl = StoreStationString(streamUrl, STATION_STRINGS_SIZE);
+	if (!station->name || !station->description || !station->streamUrl) {
+		g_stationStringsUsed = mark;
+		return 0;
+	}
+
+	g_stationCount++;
+	return 1;
+}
+
+const char* StoreStationString(const char* text, int maxLength) {
+	int length = (int)strlen(text);
+	if (length > maxLength) length = maxLength;
+	if (g_stationStringsUsed + length + 1 > STATION_STRINGS_SIZE) return NULL;
+
+	char* stored = g_stationStrings + g_stationStringsUsed;
+	memcpy(stored, text, length);
+	stored[length] = '\0';
+	g_stationStringsUsed += length + 1;
+	return stored;
+}
+
+void BuildStationIndex(StationIndex* index, const float* keys, int count,
+					   int* buckets, int maxBuckets) {
+	index->keys = keys;
+	index->count = count;
+	index->buckets = buckets;
+
+	// About one station per bucket, spread evenly over the occupied range
+	int bucketCount = count > maxBuckets ? maxBuckets : count;
+	index->bucketCount = bucketCount < 1 ? 1 : bucketCount;
+	index->low = count ? keys[0] : 0.0f;
+	float span = count ? keys[count - 1] - keys[0] : 0.0f;
+	index->scale = span > 0.0f ? index->bucketCount / span : 0.0f;
+
+	int key = 0;
+	for (int b = 0; b < index->bucketCount; b++) {
+		while (key < count && StationIndexBucket(index, keys[key]) < b) key++;
+		buckets[b] = key;
+	}
+	buckets[index->bucketCount] = count;
+}
+
+int StationIndexBucket(const StationIndex* index, float frequency) {
+	float position = (frequency - index->low) * index->scale;
+	if (position <= 0.0f) return 0;
+	if (position >= index->bucketCount - 1) return index->bucketCount - 1;
+	return (int)position;
+}
+
+int StationIndexLowerBound(const StationIndex* index, float frequency) {
+	// Buckets are monotonic in frequency, so the first key at or above
+	// the frequency is inside its bucket or is the next bucket's first
+	int bucket = StationIndexBucket(index, frequency);
+	int low = index->buckets[bucket];
+	int high = index->buckets[bucket + 1];
+	while (low < high) {
+		int middle = (low + high) / 2;
+		if (index->keys[middle] < frequency) low = middle + 1;
+		else high = middle;
+	}
+	return low;
+}
+
+int StationIndexNearest(const StationIndex* index, float frequency) {
+	if (index->count == 0) return -1;
+
+	int above = StationIndexLowerBound(index, frequency);
+	if (above == 0) return 0;
+	if (above == index->count) return above - 1;
+	float up = index->keys[above] - frequency;
+	float down = frequency - index->keys[above - 1];
+	return up < down ? above : above - 1;
+}
+
+int StationIndexNearby(const StationIndex* index, float frequency,
+					   float range, int* nearest, int max) {
+	// Walk outwards from the dial, taking the closer side each time
+	int above = StationIndexLowerBound(index, frequency);
+	int below = above - 1;
+	int found = 0;
+	while (found < max) {
+		float up = range + 1.0f;
+		float down = range + 1.0f;
+		if (above < index->count) up = index->keys[above] - frequency;
+		if (below >= 0) down = frequency - index->keys[below];
+		if (up > range && down > range) break;
+		nearest[found++] = up < down ? above++ : below--;
+	}
+	return found;
+}
+
+float GetStationSignalStrength(RadioStation* station, float currentFreq) {
+	if (!station) return 0.0f;
+
+	float distance = fabs(station->frequency - currentFreq);
+
+	// Signal strength rolls off smoothly with distance from the exact
+	// frequency, and breathes with the ionosphere
+	return station->power * SkirtResponse(distance) *
+		   IonosphericFading(station, GetTickCount());
+}
+
+void UpdateSignalStrength() {
+	// Re-evaluate the current frequency without changing stations
+	RadioStation* station = FindNearestStation(g_radio.frequency);
+	if (station) {
+		float strength = GetStationSignalStrength(station, g_radio.frequency);
+		g_radio.signalStrength = (int)(strength * 100.0f);
+	} else {
+		g_radio.signalStrength = 5 + (int)(15.0f * sin(g_radio.frequency));
+	}
+
+	if (g_radio.signalStrength < 0) g_radio.signalStrength = 0;
+	if (g_radio.signalStrength > 100) g_radio.signalStrength = 100;
+}
+
+void InitPropagationTables() {
+	for (int i = 0; i <= SKIRT_TABLE_SIZE; i++) {
+		float detune = i * SKIRT_TABLE_RANGE / SKIRT_TABLE_SIZE;
+		g_skirtTable[i] = SkirtResponseAnalytic(detune);
+	}
+}
+
+float SkirtResponseAnalytic(float detune) {
+	// Nothing is received past the capture range
+	if (detune >= SKIRT_TABLE_RANGE) return 0.0f;
+
+	// Subtract the skirt's level at the edge and rescale, so the response
+	// falls to zero there instead of stepping down by a few percent
+	float ratio = detune / SKIRT_BANDWIDTH;
+	float edgeRatio = SKIRT_TABLE_RANGE / SKIRT_BANDWIDTH;
+	float response = 1.0f / (float)sqrt(1.0 + pow(ratio, 2 * SKIRT_ORDER));
+	float edge = 1.0f / (float)sqrt(1.0 + pow(edgeRatio, 2 * SKIRT_ORDER));
+	return (response - edge) / (1.0f - edge);
+}
+
+float SkirtResponse(float detune) {
+	if (detune < 0.0f) detune = -detune;
+
+	float position = detune * (SKIRT_TABLE_SIZE / SKIRT_TABLE_RANGE);
+	if (position >= SKIRT_TABLE_SIZE) return 0.0f;
+
+	int index = (int)position;
+	float frac = position - index;
+	float a = g_skirtTable[index];
+	return a + (g_skirtTable[index + 1] - a) * frac;
+}
+
+float IonosphericFading(RadioStation* station, DWORD timeMs) {
+	// Two slow sines per station, with rates derived from its frequency
+	// so every station fades on its own schedule (periods of ~8-40 s)
+	DWORD seed = (DWORD)(station->frequency * 1000.0f);
+	float rate1 = 0.025f + (seed % 97) * 0.0008f;  // Hz
+	float rate2 = 0.06f + (seed % 61) * 0.001f;
+	// 2^32 / 1000 phase per ms for each Hz
+	DWORD phase1 = timeMs * (DWORD)(rate1 * 4294967.296f);
+	DWORD phase2 = timeMs * (DWORD)(rate2 * 4294967.296f);
+
+	// Deep fades only when both line up
+	float dip = (0.5f + 0.5f * SineLookup(phase1)) *
+				(0.5f + 0.5f * SineLookup(phase2));
+	return 1.0f - FADING_DEPTH * dip;
+}
+
+int StartBassStreaming(RadioStation* station) {
+	if (!station) {
+		Log("StartBassStreaming failed: no station\n");
+		return 0;
+	}
+
+	StopBassStreaming();
+
+	// A recent probe found nothing there; leave the static playing
+	if (IsStationOffAir(station)) {
+		StationHealth health;
+		ReadStationHealth(station, &health);
+		Log("Skipping %s: off air (%s)\n", station->name,
+			HealthErrorName(health.error));
+		return 0;
+	}
+
+	Log("Attempting to stream: %s at %s\n", station->name, station->streamUrl);
+
+	// Check if BASS is initialized
+	if (!BASS_GetVersion()) {
+		Log("BASS not initialized - cannot stream\n");
+		return 0;
+	}
+
+	// The station counts as tuned from here so dial moves don't queue it
+	// again; a warm standby stream plays at once, otherwise the connect
+	// worker opens it and we return straight away
+	g_audio.currentStation = station;
+	QueryPerformanceCounter(&g_audio.tuneStart);
+	TraceTuneStarted();
+
+	HSTREAM warm = PrefetchTake(station);
+	if (warm) {
+		ConnectCancel();
+		AttachStation(warm, "warm");
+		return 1;
+	}
+
+	ConnectRequest(station);
+	return 1;
+}
+
+void StopBassStreaming() {
+	// Supersede any connect still in flight; its stream is freed on arrival
+	ConnectCancel();
+	SupervisorReset();
+
+	if (g_audio.currentStream) {
+		// Detach before freeing so the mixer never reads a dead handle
+		MixerSetStation(0);
+		BASS_StreamFree(g_audio.currentStream);
+		g_audio.currentStream = 0;
+		Log("Stopped streaming\n");
+	}
+
+	g_audio.currentStation = NULL;
+}
+
+void OnStationReady(LONG generation, HSTREAM stream) {
+	// Retuned or powered off while this was connecting
+	if (generation != ConnectGeneration()) {
+		if (stream) BASS_StreamFree(stream);
+		return;
+	}
+
+	if (!stream) {
+		// A failed reconnect just waits for its next backoff slot
+		if (SupervisorConnectFailed()) return;
+
+		// Don't hammer a dead stream; retry once the dial has moved away
+		TunerConnectFailed(&g_tuner, g_audio.currentStation);
+		g_audio.currentStation = NULL;
+		return;
+	}
+
+	AttachStation(stream, "cold");
+}
+
+void AttachStation(HSTREAM stream, const char* source) {
+	LONGLONG traceStart = TraceBegin(&g_trace);
+	g_audio.currentStream = stream;
+	Log("Successfully connected to stream: %s (%s, %.0f ms)\n",
+		   g_audio.currentStation->name, source,
+		   GetElapsedSeconds(g_audio.tuneStart) * 1000.0);
+
+	// Get stream info
+	BASS_CHANNELINFO info;
+	if (BASS_ChannelGetInfo(stream, &info)) {
+		Log("Stream info: %lu Hz, %lu channels, type=%lu\n",
+			   info.freq, info.chans, info.ctype);
+	}
+
+	// Set volume based on signal strength and radio volume
+	UpdateStreamVolume();
+
+	// Hand the stream to the mixer; it fades in from silence
+	MixerSetStation(stream);
+	Log("Stream attached to mixer\n");
+
+	BufferControllerAttach(stream, g_audio.currentStation);
+	SupervisorWatch(stream);
+	UpdateNowPlaying(stream);  // the first block arrives with the headers
+	if (g_supervisor.dropped) {
+		DWORD recoverMs = GetTickCount() - g_supervisor.droppedAt;
+		g_supervisor.reconnects++;
+		g_supervisor.lastRecoverMs = recoverMs;
+		if (recoverMs > g_supervisor.worstRecoverMs) {
+			g_supervisor.worstRecoverMs = recoverMs;
+		}
+		Log("Reconnected after %d attempts in %lu ms "
+			"(%lu reconnects, worst %lu ms)\n",
+			   g_supervisor.attempts, recoverMs, g_supervisor.reconnects,
+			   g_supervisor.worstRecoverMs);
+
+		g_supervisor.dropped = 0;
+		g_supervisor.connecting = 0;
+		UpdateStaticVolume(g_radio.signalStrength);
+	}
+	g_trace.attachedAt = TraceEnd(&g_trace, "AttachStation",
+								  g_audio.currentStation, traceStart);
+}
+
+void SupervisorWatch(HSTREAM stream) {
+	// The callbacks run on BASS threads; they only post to the UI thread
+	BASS_ChannelSetSync(stream, BASS_SYNC_STALL, 0, StreamSyncProc,
+						(void*)BASS_SYNC_STALL);
+	BASS_ChannelSetSync(stream, BASS_SYNC_END, 0, StreamSyncProc,
+						(void*)BASS_SYNC_END);
+	BASS_ChannelSetSync(stream, BASS_SYNC_FREE, 0, StreamSyncProc,
+						(void*)BASS_SYNC_FREE);
+	BASS_ChannelSetSync(stream, BASS_SYNC_META, 0, StreamSyncProc,
+						(void*)BASS_SYNC_META);
+}
+
+void CALLBACK StreamSyncProc(HSYNC handle, DWORD channel, DWORD data,
+							 void* user) {
+	int event;
+	switch ((DWORD_PTR)user) {
+		case BASS_SYNC_STALL:
+			event = data ? STREAM_EVENT_RESUMED : STREAM_EVENT_STALLED;
+			break;
+		case BASS_SYNC_END: event = STREAM_EVENT_ENDED; break;
+		case BASS_SYNC_META: event = STREAM_EVENT_META; break;
+		default: event = STREAM_EVENT_FREED; break;
+	}
+	PostMessage(g_connect.notify, WM_STREAM_EVENT, (WPARAM)event,
+				(LPARAM)channel);
+}
+
+void OnStreamEvent(int event, HSTREAM stream) {
+	// Events from streams we have already let go of are stale
+	if (!stream || stream != g_audio.currentStream) return;
+
+	switch (event) {
+		case STREAM_EVENT_STALLED:
+			if (!g_supervisor.stalled) {
+				g_supervisor.stalled = 1;
+				g_supervisor.stalledAt = GetTickCount();
+				g_supervisor.stalls++;
+				Log("Stream stalled: %s\n", g_audio.currentStation->name);
+			}
+			break;
+		case STREAM_EVENT_RESUMED:
+			g_supervisor.stalled = 0;
+			break;
+		case STREAM_EVENT_ENDED:
+			SupervisorDrop("ended");
+			break;
+		case STREAM_EVENT_FREED:
+			// Already gone; make sure nothing touches the handle again
+			MixerSetStation(0);
+			g_audio.currentStream = 0;
+			SupervisorDrop("freed");
+			break;
+		case STREAM_EVENT_META:
+			UpdateNowPlaying(stream);
+			break;
+	}
+}
+
+void UpdateNowPlaying(HSTREAM stream) {
+	const char* meta = BASS_ChannelGetTags(stream, BASS_TAG_META);
+	RadioStation* station = g_audio.currentStation;
+	if (!meta || !station) return;
+
+	// Repaint just the station strip, and only for a new title
+	char* title = GetNowPlaying(station);
+	if (IcyParseTitle(meta, title, ICY_TITLE_SIZE) > 0) {
+		Log("Now playing on %s: %s\n", station->name, title);
+		InvalidateRect(g_connect.notify, &g_stationStrip, FALSE);
+	}
+}
+
+char* GetNowPlaying(RadioStation* station) {
+	// Kept apart from the directory so scans over it stay compact
+	return g_nowPlaying[station - g_stations];
+}
+
+int IcyParseTitle(const char* meta, char* title, int titleSize) {
+	// ICY metadata is "StreamTitle='Artist - Song';StreamUrl='...';"; the
+	// title may itself contain quotes, so it ends at the first "';"
+	const char* start = strstr(meta, "StreamTitle='");
+	if (!start || titleSize < 1) return -1;
+	start += 13;
+
+	const char* end = strstr(start, "';");
+	if (!end) {
+		// Truncated block: take the rest, minus a dangling closing quote
+		end = start + strlen(start);
+		if (end > start && end[-1] == '\'') end--;
+	}
+
+	// Write over the old title in place, noting whether anything differs
+	int length = (int)(end - start);
+	if (length > titleSize - 1) length = titleSize - 1;
+
+	int changed = 0;
+	for (int i = 0; i < length; i++) {
+		char c = start[i];
+		// No control codes on the display
+		if ((unsigned char)c < 0x20) c = ' ';
+		if (title[i] != c) {
+			title[i] = c;
+			changed = 1;
+		}
+	}
+	if (title[length] != '\0') {
+		title[length] = '\0';
+		changed = 1;
+	}
+	return changed;
+}
+
+void SupervisorDrop(const char* reason) {
+	if (!g_audio.currentStation) return;
+
+	Log("Lost %s (%s), reconnecting\n", g_audio.currentStation->name, reason);
+
+	// Keep the station tuned but silent; the static carries on
+	if (g_audio.currentStream) {
+		HSTREAM stream = g_audio.currentStream;
+		MixerSetStation(0);
+		g_audio.currentStream = 0;
+		BASS_StreamFree(stream);
+	}
+
+	DWORD now = GetTickCount();
+	if (!g_supervisor.dropped) {
+		g_supervisor.dropped = 1;
+		g_supervisor.droppedAt = now;
+		g_supervisor.attempts = 0;
+		if (!g_supervisor.jitter.lane[0]) NoiseSeed(&g_supervisor.jitter, now);
+	}
+	g_supervisor.stalled = 0;
+	g_supervisor.connecting = 0;
+	g_supervisor.nextAttemptAt = now + SupervisorBackoff(g_supervisor.attempts);
+
+	UpdateStaticVolume(g_radio.signalStrength);
+}
+
+void SupervisorTick(DWORD now) {
+	if (g_supervisor.stalled &&
+		now - g_supervisor.stalledAt >= RECONNECT_STALL_MS) {
+		SupervisorDrop("stalled");
+	}
+
+	// Decoding channels never raise BASS_SYNC_STALL, and the mixer stops
+	// pulling before the buffer empties, so BASS_SYNC_END doesn't arrive
+	// either. A playing station starved this long is a drop all the same;
+	// the buffer controller reports a closed connection once it drains
+	if (g_audio.currentStream && !g_mixer.awaitingAudio && g_mixer.starved &&
+		now - g_mixer.starvedSince >= RECONNECT_STALL_MS) {
+		SupervisorDrop("starved");
+	}
+
+	if (!g_supervisor.dropped || g_supervisor.connecting ||
+		!g_audio.currentStation) {
+		return;
+	}
+	if ((LONG)(now - g_supervisor.nextAttemptAt) < 0) return;
+
+	// Straight to the connect worker: going through StartBassStreaming
+	// would reset the supervisor along with the old stream
+	g_supervisor.connecting = 1;
+	g_supervisor.attempts++;
+	Log("Reconnect attempt %d: %s\n", g_supervisor.attempts,
+		g_audio.currentStation->name);
+	QueryPerformanceCounter(&g_audio.tuneStart);
+	TraceTuneStarted();
+	ConnectRequest(g_audio.currentStation);
+}
+
+void SupervisorReset() {
+	g_supervisor.dropped = 0;
+	g_supervisor.connecting = 0;
+	g_supervisor.stalled = 0;
+	g_supervisor.attempts = 0;
+}
+
+int SupervisorConnectFailed() {
+	if (!g_supervisor.dropped) return 0;
+
+	g_supervisor.connecting = 0;
+	g_supervisor.nextAttemptAt = GetTickCount() +
+								 SupervisorBackoff(g_supervisor.attempts);
+	return 1;
+}
+
+DWORD SupervisorBackoff(int attempts) {
+	// Exponential with "equal jitter": half fixed, half random, so a
+	// whole room of radios doesn't hit the server in lockstep
+	DWORD delay = RECONNECT_MAX_MS;
+	if (attempts < 16) {
+		delay = RECONNECT_BASE_MS << attempts;
+		if (delay > RECONNECT_MAX_MS) delay = RECONNECT_MAX_MS;
+	}
+	float jitter = NoiseRandomUnit(&g_supervisor.jitter);
+	return delay / 2 + (DWORD)(delay / 2 * jitter);
+}
+
+void PrintStreamError(RadioStation* station, DWORD error) {
+	Log("Failed to connect to stream: %s (BASS Error: %lu)\n",
+		station->name, error);
+	Log("BASS Error meanings:\n");
+	Log("  1 = BASS_ERROR_MEM (out of memory)\n");
+	Log("  2 = BASS_ERROR_FILEOPEN (file/URL cannot be opened)\n");
+	Log("  3 = BASS_ERROR_DRIVER (no audio driver available)\n");
+	Log("  6 = BASS_ERROR_FORMAT (unsupported format)\n");
+	Log("  7 = BASS_ERROR_POSITION (invalid position)\n");
+	Log("  14 = BASS_ERROR_DEVICE (invalid device)\n");
+	Log("  21 = BASS_ERROR_TIMEOUT (connection timeout)\n");
+	Log("  41 = BASS_ERROR_SSL (SSL/HTTPS not supported)\n");
+}
+
+void TunerReset(Tuner* tuner) {
+	tuner->state = TUNER_IDLE;
+	tuner->locked = NULL;
+	tuner->candidate = NULL;
+	tuner->failed = NULL;
+}
+
+void TunerConnectFailed(Tuner* tuner, RadioStation* station) {
+	if (tuner->locked == station) {
+		tuner->locked = NULL;
+		tuner->state = TUNER_IDLE;
+		tuner->failed = station;
+	}
+}
+
+int TunerStep(Tuner* tuner, RadioStation* station, int strength, DWORD now) {
+	// A station strong enough to lock onto, restarting the dwell whenever
+	// it changes
+	RadioStation* candidate = NULL;
+	if (station && strength > TUNER_LOCK_THRESHOLD) candidate = station;
+	if (candidate != tuner->candidate) {
+		tuner->candidate = candidate;
+		tuner->candidateSince = now;
+	}
+	if (tuner->failed && station != tuner->failed) {
+		tuner->failed = NULL;
+	}
+
+	int settled = candidate && candidate != tuner->failed &&
+				  now - tuner->candidateSince >= TUNER_DWELL_MS;
+
+	if (tuner->locked) {
+		if (station == tuner->locked && strength >= TUNER_DROP_THRESHOLD) {
+			tuner->state = TUNER_LOCKED;
+			return TUNER_ACTION_NONE;
+		}
+
+		if (tuner->state != TUNER_LOSING) {
+			tuner->state = TUNER_LOSING;
+			tuner->lostSince = now;
+		}
+
+		// Settling on another station replaces this one straight away
+		if (settled && candidate != tuner->locked) {
+			tuner->locked = candidate;
+			tuner->state = TUNER_LOCKED;
+			tuner->disconnects++;
+			tuner->connects++;
+			return TUNER_ACTION_CONNECT;
+		}
+
+		if (now - tuner->lostSince < TUNER_GRACE_MS) {
+			return TUNER_ACTION_NONE;
+		}
+
+		tuner->locked = NULL;
+		tuner->state = TUNER_IDLE;
+		tuner->disconnects++;
+		return TUNER_ACTION_DISCONNECT;
+	}
+
+	if (settled) {
+		tuner->locked = candidate;
+		tuner->state = TUNER_LOCKED;
+		tuner->connects++;
+		return TUNER_ACTION_CONNECT;
+	}
+
+	tuner->state = candidate ? TUNER_SETTLING : TUNER_IDLE;
+	return TUNER_ACTION_NONE;
+}
+
+void TunerUpdate() {
+	// Nothing to connect while the set is off, nor while a measurement
+	// run has a stand-in station tuned
+	if (!g_radio.power || g_ttfaRunning) return;
+
+	LONGLONG traceStart = TraceBegin(&g_trace);
+	RadioStation* station = FindNearestStation(g_radio.frequency);
+	LONGLONG traceFound = TraceBegin(&g_trace);
+	int action = TunerStep(&g_tuner, station, g_radio.signalStrength,
+						   GetTickCount());
+	switch (action) {
+		case TUNER_ACTION_CONNECT: {
+			LONGLONG traceConnect = TraceBegin(&g_trace);
+			int started = StartBassStreaming(g_tuner.locked);
+			// Lookups run every tick; only the one that tuned is kept
+			TraceRecord(&g_trace, "FindNearestStation", station,
+						GetCurrentThreadId(), traceStart, traceFound);
+			TraceEnd(&g_trace, "StartBassStreaming", g_tuner.locked,
+					 traceConnect);
+			if (!started) {
+				// Not retried until the dial leaves it
+				TunerConnectFailed(&g_tuner, g_tuner.locked);
+				break;
+			}
+			Log("Tuner: connect #%lu\n", g_tuner.connects);
+			break;
+		}
+		case TUNER_ACTION_DISCONNECT:
+			StopBassStreaming();
+			Log("Tuner: disconnect #%lu\n", g_tuner.disconnects);
+			break;
+	}
+}
+
+void LatencyRecord(LatencyHistory* history, float ms) {
+	history->ms[history->next] = ms;
+	history->next = (history->next + 1) % TTFA_HISTORY;
+	if (history->count < TTFA_HISTORY) history->count++;
+}
+
+float LatencyPercentile(LatencyHistory* history, float percentile) {
+	float sorted[TTFA_HISTORY];
+	int count = history->count;
+	if (count == 0) return 0.0f;
+
+	// Insertion sort; the history is tiny
+	for (int i = 0; i < count; i++) {
+		float value = history->ms[i];
+		int j = i;
+		for (; j > 0 && sorted[j - 1] > value; j--) {
+			sorted[j] = sorted[j - 1];
+		}
+		sorted[j] = value;
+	}
+
+	// Nearest rank
+	int rank = (int)ceil(percentile / 100.0f * count) - 1;
+	if (rank < 0) rank = 0;
+	if (rank >= count) rank = count - 1;
+	return sorted[rank];
+}
+
+void CheckFirstAudio() {
+	if (!InterlockedExchange(&g_mixer.firstAudio, 0)) return;
+
+	LARGE_INTEGER frequency;
+	QueryPerformanceFrequency(&frequency);
+	LONGLONG ticks = g_mixer.firstAudioAt.QuadPart - g_audio.tuneStart.QuadPart;
+	float ms = (float)(ticks * 1000.0 / frequency.QuadPart);
+	LatencyRecord(&g_ttfa, ms);
+	TelemetryFirstAudio(ms);
+	TraceFirstAudio(g_mixer.firstAudioAt.QuadPart);
+	Log("Time to first audio: %.0f ms (p50 %.0f, p99 %.0f over %d tunes)\n",
+		   ms, LatencyPercentile(&g_ttfa, 50.0f),
+		   LatencyPercentile(&g_ttfa, 99.0f), g_ttfa.count);
+	if (g_ttfaRunning && g_ttfaHeard) {
+		g_ttfaHeardMs = ms;
+		SetEvent(g_ttfaHeard);
+	}
+}
+
+void StartTtfaMeasurement() {
+	if (InterlockedExchange(&g_ttfaRunning, 1)) {
+		Log("Time to first audio measurement already running\n");
+		return;
+	}
+
+	HANDLE thread = CreateThread(NULL, 0, TtfaMeasurementProc, NULL, 0, NULL);
+	if (thread) {
+		CloseHandle(thread);
+	} else {
+		InterlockedExchange(&g_ttfaRunning, 0);
+	}
+}
+
+void Log(const char* format, ...) {
+	va_list args;
+	va_start(args, format);
+	LogWrite(&g_log, format, args);
+	va_end(args);
+}
+
+void LogRingInit(LogRing* ring) {
+	for (int i = 0; i < LOG_RING_SIZE; i++) {
+		ring->records[i].sequence = i;
+	}
+	ring->head = 0;
+	ring->tail = 0;
+	ring->dropped = 0;
+	ring->reportedDropped = 0;
+}
+
+int LogWrite(LogRing* ring, const char* format, va_list args) {
+	// Claim a slot: it is free when its sequence equals our position.
+	// Losing the race just means trying the next position
+	LONG position = ring->head;
+	LogRecord* record;
+	for (;;) {
+		record = &ring->records[position & (LOG_RING_SIZE - 1)];
+		LONG lag = record->sequence - position;
+		if (lag == 0) {
+			LONG seen = InterlockedCompareExchange(&ring->head, position + 1,
+												   position);
+			if (seen == position) break;
+			position = seen;
+		} else if (lag < 0) {
+			// The drain is a whole ring behind
+			InterlockedIncrement(&ring->dropped);
+			return 0;
+		} else {
+			position = ring->head;
+		}
+	}
+
+	record->time = GetTickCount();
+	record->thread = GetCurrentThreadId();
+	record->format = format;
+
+	// Capture each conversion by type so the drain can format it later;
+	// strings are copied since the caller's buffer may not outlive us
+	int count = 0;
+	int textUsed = 0;
+	for (const char* c = format; *c && count < LOG_MAX_ARGS; c++) {
+		if (*c != '%') continue;
+		c++;
+		while (*c && strchr("-+ #0123456789.", *c)) c++;
+		// 0 = int, 1 = long, 2 = 64-bit
+		int size = 0;
+		while (*c == 'l' || *c == 'h' || *c == 'I' || *c == '6' || *c == '4') {
+			if (*c == 'l') size++;
+			if (*c == 'I') size = 2;
+			c++;
+		}
+
+		LogArg* arg = &record->args[count];
+		switch (*c) {
+			case 'd': case 'i': case 'c':
+				arg->i = size == 2 ? va_arg(args, LONGLONG)
+					   : size ? va_arg(args, long)
+					   : va_arg(args, int);
+				count++;
+				break;
+			case 'u': case 'x': case 'X': case 'o':
+				arg->i = size == 2 ? (LONGLONG)va_arg(args, ULONGLONG)
+					   : size ? (LONGLONG)va_arg(args, unsigned long)
+					   : (LONGLONG)va_arg(args, unsigned int);
+				count++;
+				break;
+			case 'f': case 'F': case 'g': case 'G': case 'e': case 'E':
+				arg->d = va_arg(args, double);
+				count++;
+				break;
+			case 'p':
+				arg->p = va_arg(args, void*);
+				count++;
+				break;
+			case 's': {
+				const char* text = va_arg(args, const char*);
+				if (!text) text = "(null)";
+				int length = (int)strlen(text);
+				int room = LOG_TEXT_SIZE - 1 - textUsed;
+				if (length > room) length = room;
+				memcpy(record->text + textUsed, text, length);
+				record->text[textUsed + length] = '\0';
+				arg->text = textUsed;
+				textUsed += length + (length < room ? 1 : 0);
+				count++;
+				break;
+			}
+			case '\0':
+				c--;
+				break;
+		}
+	}
+	record->argCount = count;
+
+	// Publish: the drain may read it from here on
+	InterlockedExchange(&record->sequence, position + 1);
+	return 1;
+}
+
+int LogFormat(const LogRecord* record, char* out, int size) {
+	// Walk the format again, handing each conversion its captured value
+	int used = 0;
+	int arg = 0;
+	const char* c = record->format;
+	while (*c && used < size - 1) {
+		if (*c != '%') {
+			out[used++] = *c++;
+			continue;
+		}
+
+		char spec[16];
+		const char* start = c++;
+		while (*c && strchr("-+ #0123456789.lhI64", *c)) c++;
+		if (!*c) break;
+		int length = (int)(c - start) + 1;
+		if (length >= (int)sizeof(spec)) length = sizeof(spec) - 1;
+		memcpy(spec, start, length);
+		spec[length] = '\0';
+		c++;
+
+		int wrote = 0;
+		const LogArg* value = NULL;
+		if (arg < record->argCount) value = &record->args[arg];
+		int wide = strstr(spec, "ll") || strstr(spec, "I64");
+		int isLong = !wide && strchr(spec, 'l');
+		switch (spec[length - 1]) {
+			case '%':
+				wrote = 1;
+				out[used] = '%';
+				break;
+			case 'd': case 'i': case 'c':
+			case 'u': case 'x': case 'X': case 'o':
+				if (!value) break;
+				wrote = wide ? snprintf(out + used, size - used, spec, value->i)
+					  : isLong ? snprintf(out + used, size - used, spec,
+										  (long)value->i)
+					  : snprintf(out + used, size - used, spec, (int)value->i);
+				arg++;
+				break;
+			case 'f': case 'F': case 'g': case 'G': case 'e': case 'E':
+				if (!value) break;
+				wrote = snprintf(out + used, size - used, spec, value->d);
+				arg++;
+				break;
+			case 'p':
+				if (!value) break;
+				wrote = snprintf(out + used, size - used, spec, value->p);
+				arg++;
+				break;
+			case 's':
+				if (!value) break;
+				wrote = snprintf(out + used, size - used, spec,
+								 record->text + value->text);
+				arg++;
+				break;
+		}
+		if (wrote < 0 || wrote > size - 1 - used) wrote = size - 1 - used;
+		used += wrote;
+	}
+	out[used] = '\0';
+	return used;
+}
+
+int LogDrainRing(LogRing* ring, char* buffer, int size, LogSink sink) {
+	int drained = 0;
+	for (;;) {
+		LogRecord* record = &ring->records[ring->tail & (LOG_RING_SIZE - 1)];
+		if (record->sequence != ring->tail + 1) break;
+
+		LogFormat(record, buffer, size);
+		if (sink) sink(buffer, record);
+
+		// Hand the slot back to producers for the next lap
+		InterlockedExchange(&record->sequence, ring->tail + LOG_RING_SIZE);
+		ring->tail++;
+		drained++;
+	}
+	return drained;
+}
+
+int LogSinkOutput(const char* text, const LogRecord* record) {
+	// Console text as it always looked; the file gets time and thread
+	if (g_consoleWindow) fputs(text, stdout);
+
+	if (!g_logDrain.file) return 0;
+	if (g_logDrain.fileBytes > LOG_FILE_MAX) {
+		// Keep one previous file
+		char path[MAX_PATH], old[MAX_PATH];
+		fclose(g_logDrain.file);
+		g_logDrain.file = NULL;
+		if (GetAppFilePath(LOG_FILE, path) &&
+			GetAppFilePath(LOG_FILE_OLD, old)) {
+			MoveFileEx(path, old, MOVEFILE_REPLACE_EXISTING);
+			g_logDrain.file = fopen(path, "w");
+		}
+		g_logDrain.fileBytes = 0;
+		if (!g_logDrain.file) return 0;
+	}
+
+	int written = fprintf(g_logDrain.file, "%10lu %5lu %s", record->time,
+						  record->thread, text);
+	if (written > 0) g_logDrain.fileBytes += written;
+	return 1;
+}
+
+DWORD WINAPI LogDrainProc(LPVOID param) {
+	static char buffer[1024];
+	LogRecord dropped = {};
+	dropped.format = "";
+	for (;;) {
+		int quitting = g_logDrain.quit;
+		int drained = LogDrainRing(&g_log, buffer, sizeof(buffer),
+								   LogSinkOutput);
+
+		LONG lost = g_log.dropped;
+		if (lost != g_log.reportedDropped) {
+			dropped.time = GetTickCount();
+			sprintf(buffer, "Log: %ld messages dropped\n",
+					lost - g_log.reportedDropped);
+			LogSinkOutput(buffer, &dropped);
+			g_log.reportedDropped = lost;
+		}
+
+		if (drained) {
+			if (g_consoleWindow) fflush(stdout);
+			if (g_logDrain.file) fflush(g_logDrain.file);
+		}
+		if (quitting) break;
+		Sleep(LOG_DRAIN_MS);
+	}
+	return 0;
+}
+
+int StartLogging() {
+	char path[MAX_PATH];
+	if (GetAppFilePath(LOG_FILE, path)) {
+		g_logDrain.file = fopen(path, "a");
+	}
+	if (g_logDrain.file) {
+		fseek(g_logDrain.file, 0, SEEK_END);
+		g_logDrain.fileBytes = (DWORD)ftell(g_logDrain.file);
+	}
+
+	g_logDrain.quit = 0;
+	g_logDrain.thread = CreateThread(NULL, 0, LogDrainProc, NULL, 0, NULL);
+	if (!g_logDrain.thread) return 0;
+
+	SetThreadPriority(g_logDrain.thread, THREAD_PRIORITY_LOWEST);
+	return 1;
+}
+
+void StopLogging() {
+	// The drain makes one last pass after seeing quit
+	if (g_logDrain.thread) {
+		InterlockedExchange(&g_logDrain.quit, 1);
+		WaitForSingleObject(g_logDrain.thread, INFINITE);
+		CloseHandle(g_logDrain.thread);
+		g_logDrain.thread = NULL;
+	}
+	if (g_logDrain.file) fclose(g_logDrain.file);
+	g_logDrain.file = NULL;
+}
+
+LONGLONG TraceBegin(Trace* trace) {
+	// Off: one load and a branch, no clock read
+	if (!trace->enabled) return 0;
+
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+	return now.QuadPart;
+}
+
+LONGLONG TraceEnd(Trace* trace, const char* name, RadioStation* station,
+				  LONGLONG start) {
+	// Spans begun while tracing was off are never recorded
+	if (!start) return 0;
+
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+	TraceRecord(trace, name, station, GetCurrentThreadId(), start,
+				now.QuadPart);
+	return now.QuadPart;
+}
+
+void TraceRecord(Trace* trace, const char* name, RadioStation* station,
+				 DWORD thread, LONGLONG start, LONGLONG end) {
+	if (!start || !trace->enabled) return;
+
+	// Any thread may record; the ring simply wraps over the oldest events
+	LONG claim = InterlockedIncrement(&trace->next) - 1;
+	TraceEvent* event = &trace->events[claim & (TRACE_EVENTS - 1)];
+	InterlockedExchange(&event->sequence, 0);
+	event->name = name;
+	event->station = station;
+	event->thread = thread;
+	event->tune = trace->tune;
+	event->start = start;
+	event->duration = end > start ? end - start : 0;
+	InterlockedExchange(&event->sequence, claim + 1);
+}
+
+void TraceEnable(int enabled) {
+	InterlockedExchange(&g_trace.enabled, enabled);
+	g_trace.painting = 0;
+	g_trace.audible = 0;
+	Log("Tune tracing %s\n", enabled ? "on" : "off");
+}
+
+void TraceTuneStarted() {
+	if (!g_trace.enabled) return;
+
+	InterlockedIncrement(&g_trace.tune);
+	g_trace.painting = 1;
+	g_trace.audible = 0;
+	g_trace.attachedAt = 0;
+}
+
+void TraceFirstAudio(LONGLONG at) {
+	if (!g_trace.enabled || !g_trace.painting) return;
+
+	// The mixer timestamped its first pull; the levels it meters always
+	// carry static, so this is the first moment the station is audible
+	RadioStation* station = g_audio.currentStation;
+	if (g_trace.attachedAt && g_trace.attachedAt < at) {
+		TraceRecord(&g_trace, "prebuffer and first decode", station,
+					TRACE_TUNE_THREAD, g_trace.attachedAt, at);
+	}
+	TraceRecord(&g_trace, "time to first audio", station, TRACE_TUNE_THREAD,
+				g_audio.tuneStart.QuadPart, at);
+	g_trace.audible = 1;
+}
+
+void TracePainted(LONGLONG start) {
+	LONGLONG end = TraceEnd(&g_trace, "WM_PAINT", g_audio.currentStation,
+							start);
+	if (!end || !g_trace.audible) return;
+
+	// The first frame drawn with the station playing closes the tune
+	TraceRecord(&g_trace, "tune", g_audio.currentStation, TRACE_TUNE_THREAD,
+				g_audio.tuneStart.QuadPart, end);
+	g_trace.painting = 0;
+	g_trace.audible = 0;
+}
+
+void TraceWriteString(FILE* file, const char* text) {
+	fputc('"', file);
+	for (const char* c = text; *c; c++) {
+		if (*c == '"' || *c == '\\') {
+			fputc('\\', file);
+			fputc(*c, file);
+		} else if ((unsigned char)*c < 0x20) {
+			fprintf(file, "\\u%04x", (unsigned char)*c);
+		} else {
+			fputc(*c, file);
+		}
+	}
+	fputc('"', file);
+}
+
+int TraceExportJson() {
+	static TraceEvent events[TRACE_EVENTS];
+	char path[MAX_PATH];
+	if (!GetAppFilePath(TRACE_FILE, path)) return 0;
+
+	// Copy out first. A slot being rewritten reads as cleared or with a
+	// newer claim on one side of the copy and is left out
+	LONG next = g_trace.next;
+	LONG first = next > TRACE_EVENTS ? next - TRACE_EVENTS : 0;
+	int count = 0;
+	LONGLONG origin = 0;
+	for (LONG claim = first; claim < next; claim++) {
+		TraceEvent* slot = &g_trace.events[claim & (TRACE_EVENTS - 1)];
+		if (slot->sequence != claim + 1) continue;
+		memcpy(&events[count], slot, sizeof(TraceEvent));
+		if (slot->sequence != claim + 1) continue;
+		if (!count || events[count].start < origin) {
+			origin = events[count].start;
+		}
+		count++;
+	}
+
+	FILE* file = fopen(path, "w");
+	if (!file) {
+		Log("Cannot write %s\n", path);
+		return 0;
+	}
+
+	LARGE_INTEGER frequency;
+	QueryPerformanceFrequency(&frequency);
+	double usPerTick = 1e6 / (double)frequency.QuadPart;
+
+	// Complete ("X") events in microseconds from the earliest one
+	fprintf(file, "{\"traceEvents\":[\n");
+	fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+				  "\"tid\":%d,\"args\":{\"name\":\"tunes\"}},\n",
+			TRACE_TUNE_THREAD);
+	fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+				  "\"tid\":%lu,\"args\":{\"name\":\"UI\"}}",
+			GetCurrentThreadId());
+	for (int i = 0; i < count; i++) {
+		TraceEvent* event = &events[i];
+		fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"tune\",\"ph\":\"X\","
+					  "\"ts\":%.3f,\"dur\":%.3f,"
+					  "\"pid\":1,\"tid\":%lu,\"args\":{\"tune\":%ld",
+				event->name, (event->start - origin) * usPerTick,
+				event->duration * usPerTick, event->thread, event->tune);
+		if (event->station) {
+			fprintf(file, ",\"station\":");
+			TraceWriteString(file, event->station->name);
+		}
+		fprintf(file, "}}");
+	}
+	fprintf(file, "\n],\"displayTimeUnit\":\"ms\"}\n");
+
+	int ok = fclose(file) == 0;
+	Log("Trace: %d events written to %s\n", count, path);
+	return ok;
+}
+
+void TelemetryTick() {
+	float cpu = BASS_GetCPU();
+	TelemetrySampleStream(&g_telemetry.streams[0], g_audio.currentStream,
+						  g_audio.currentStation, cpu);
+
+	// Standbys belong to the prefetch thread; if it holds the lock just
+	// skip them this tick
+	HSTREAM standby[PREFETCH_MAX_STREAMS] = {};
+	RadioStation* standbyStation[PREFETCH_MAX_STREAMS] = {};
+	if (TryEnterCriticalSection(&g_prefetch.lock)) {
+		for (int i = 0; i < PREFETCH_MAX_STREAMS; i++) {
+			standby[i] = g_prefetch.pool[i].stream;
+			standbyStation[i] = g_prefetch.pool[i].station;
+		}
+		LeaveCriticalSection(&g_prefetch.lock);
+		for (int i = 0; i < PREFETCH_MAX_STREAMS; i++) {
+			TelemetrySampleStream(&g_telemetry.streams[1 + i], standby[i],
+								  standbyStation[i], cpu);
+		}
+	}
+
+	if (g_telemetry.viewing && ++g_telemetry.ticks >= TELEMETRY_VIEW_TICKS) {
+		g_telemetry.ticks = 0;
+		TelemetryPrint();
+	}
+}
+
+void TelemetrySampleStream(TelemetryStream* slot, HSTREAM stream,
+						   RadioStation* station, float cpu) {
+	// A new connection starts a new history
+	if (stream != slot->stream) {
+		slot->stream = stream;
+		slot->station = station;
+		slot->count = 0;
+		slot->next = 0;
+		slot->lastAt.QuadPart = 0;
+		slot->ttfaMs = 0.0f;
+	}
+	if (!stream) return;
+
+	QWORD decoded = BASS_StreamGetFilePosition(stream, BASS_FILEPOS_CURRENT);
+	QWORD buffered = BASS_StreamGetFilePosition(stream, BASS_FILEPOS_BUFFER);
+	if (decoded == (QWORD)-1 || buffered == (QWORD)-1) return;
+
+	// The first reading of a connection is only the baseline for the rate
+	QWORD received = decoded + buffered;
+	float seconds = slot->lastAt.QuadPart
+		? (float)GetElapsedSeconds(slot->lastAt) : 0.0f;
+	QWORD lastReceived = slot->lastReceived;
+	slot->lastReceived = received;
+	QueryPerformanceCounter(&slot->lastAt);
+	if (seconds <= 0.0f) return;
+
+	TelemetrySample* sample = &slot->samples[slot->next];
+	QWORD arrived = received >= lastReceived ? received - lastReceived : 0;
+	sample->downloadKBps = arrived / 1000.0f / seconds;
+
+	float bitrate = 0.0f;
+	BASS_ChannelGetAttribute(stream, BASS_ATTRIB_BITRATE, &bitrate);
+	sample->time = GetTickCount();
+	sample->bufferKB = buffered / 1000.0f;
+	sample->bufferSeconds = bitrate > 0.0f
+		? buffered * 8.0f / 1000.0f / bitrate : 0.0f;
+	sample->bitrate = bitrate;
+	sample->cpu = cpu;
+	// Only the attached stream is pulled, so only it can run dry
+	int attached = slot == &g_telemetry.streams[0] && stream == g_mixer.station;
+	sample->stalls = attached ? (DWORD)g_mixer.stationStalls : 0;
+	sample->underruns = attached ? (DWORD)g_mixer.stationUnderruns : 0;
+	sample->ttfaMs = slot->ttfaMs;
+
+	slot->next = (slot->next + 1) % TELEMETRY_HISTORY;
+	if (slot->count < TELEMETRY_HISTORY) slot->count++;
+}
+
+void TelemetryFirstAudio(float ms) {
+	g_telemetry.streams[0].ttfaMs = ms;
+}
+
+float TelemetryPercentile(TelemetryStream* slot, size_t field,
+						  float percentile) {
+	static float sorted[TELEMETRY_HISTORY];
+	if (slot->count == 0) return 0.0f;
+
+	for (int i = 0; i < slot->count; i++) {
+		sorted[i] = *(float*)((char*)&slot->samples[i] + field);
+	}
+	qsort(sorted, slot->count, sizeof(float), CompareFloats);
+
+	// Nearest rank, as for the time to first audio
+	int rank = (int)ceil(percentile / 100.0f * slot->count) - 1;
+	if (rank < 0) rank = 0;
+	return sorted[rank];
+}
+
+void TelemetryPrint() {
+	TelemetryStream* playing = &g_telemetry.streams[0];
+	size_t cpu = offsetof(TelemetrySample, cpu);
+	size_t download = offsetof(TelemetrySample, downloadKBps);
+	size_t buffer = offsetof(TelemetrySample, bufferSeconds);
+	Log("Telemetry: CPU %.1f%% (p95 %.1f), %ld underruns, %lu reconnects, "
+		   "TTFA p50 %.0f ms over %d tunes\n",
+		   BASS_GetCPU(), TelemetryPercentile(playing, cpu, 95.0f),
+		   g_mixer.underruns, g_supervisor.reconnects,
+		   LatencyPercentile(&g_ttfa, 50.0f), g_ttfa.count);
+
+	for (int i = 0; i < TELEMETRY_STREAMS; i++) {
+		TelemetryStream* slot = &g_telemetry.streams[i];
+		if (!slot->stream || slot->count == 0) continue;
+
+		int newest = (slot->next + TELEMETRY_HISTORY - 1) % TELEMETRY_HISTORY;
+		TelemetrySample* last = &slot->samples[newest];
+		Log("  %-7s %-20s down %6.1f kB/s (p50 %.1f, p5 %.1f)  "
+			"buffer %5.1f kB, %4.1f s (p5 %.1f s)  %.0f kbps  "
+			"%lu underruns, %lu stalls\n",
+			   i == 0 ? "playing" : "standby",
+			   slot->station ? slot->station->name : "?",
+			   last->downloadKBps,
+			   TelemetryPercentile(slot, download, 50.0f),
+			   TelemetryPercentile(slot, download, 5.0f),
+			   last->bufferKB, last->bufferSeconds,
+			   TelemetryPercentile(slot, buffer, 5.0f),
+			   last->bitrate, last->underruns, last->stalls);
+	}
+}
+
+int TelemetryExportCsv() {
+	char path[MAX_PATH];
+	if (!GetAppFilePath(TELEMETRY_FILE, path)) return 0;
+
+	FILE* file = fopen(path, "w");
+	if (!file) {
+		Log("Cannot write %s\n", path);
+		return 0;
+	}
+
+	// One row per sample, oldest first, each connection in turn
+	fprintf(file, "time_ms,connection,station,download_kBps,buffer_kB,"
+				  "buffer_s,bitrate_kbps,cpu_percent,stalls,underruns,"
+				  "ttfa_ms\n");
+	int rows = 0;
+	for (int i = 0; i < TELEMETRY_STREAMS; i++) {
+		TelemetryStream* slot = &g_telemetry.streams[i];
+		const char* connection = i == 0 ? "playing" : "standby";
+		const char* name = slot->station ? slot->station->name : "";
+		int first = slot->next + TELEMETRY_HISTORY - slot->count;
+		for (int n = 0; n < slot->count; n++) {
+			int index = (first + n) % TELEMETRY_HISTORY;
+			TelemetrySample* sample = &slot->samples[index];
+			fprintf(file, "%lu,%s,\"", sample->time, connection);
+			for (const char* c = name; *c; c++) {
+				if (*c == '"') fputc('"', file);
+				fputc(*c, file);
+			}
+			fprintf(file, "\",%.2f,%.2f,%.3f,%.0f,%.2f,%lu,%lu,%.0f\n",
+					sample->downloadKBps, sample->bufferKB,
+					sample->bufferSeconds, sample->bitrate, sample->cpu,
+					sample->stalls, sample->underruns, sample->ttfaMs);
+			rows++;
+		}
+	}
+
+	int ok = fclose(file) == 0;
+	Log("Telemetry: %d samples written to %s\n", rows, path);
+	return ok;
+}
+
+double GetThreadCpuSeconds() {
+	FILETIME created, exited, kernel, user;
+	if (!GetThreadTimes(GetCurrentThread(), &created, &exited, &kernel,
+						&user)) {
+		return 0.0;
+	}
+
+	ULARGE_INTEGER k, u;
+	k.LowPart = kernel.dwLowDateTime;
+	k.HighPart = kernel.dwHighDateTime;
+	u.LowPart = user.dwLowDateTime;
+	u.HighPart = user.dwHighDateTime;
+	return (double)(k.QuadPart + u.QuadPart) * 1e-7;  // 100 ns units
+}
+
+double GetProcessCpuSeconds() {
+	FILETIME created, exited, kernel, user;
+	if (!GetProcessTimes(GetCurrentProcess(), &created, &exited, &kernel,
+						 &user)) {
+		return 0.0;
+	}
+
+	ULARGE_INTEGER k, u;
+	k.LowPart = kernel.dwLowDateTime;
+	k.HighPart = kernel.dwHighDateTime;
+	u.LowPart = user.dwLowDateTime;
+	u.HighPart = user.dwHighDateTime;
+	return (double)(k.QuadPart + u.QuadPart) * 1e-7;  // 100 ns units
+}
+
+DWORD WINAPI TtfaMeasurementProc(LPVOID param) {
+	LatencyHistory history = {};
+
+	// Stand-in stations go through the real tune path, so the set has to
+	// be on with the mixer pulling
+	if (!g_radio.power) {
+		Log("Time to first audio: switch the radio on first\n");
+		InterlockedExchange(&g_ttfaRunning, 0);
+		return 0;
+	}
+	if (!g_ttfaHeard) g_ttfaHeard = CreateEvent(NULL, FALSE, FALSE, NULL);
+	if (!g_ttfaHeard || !StandinStart()) {
+		Log("Time to first audio: cannot start the stand-in server\n");
+		InterlockedExchange(&g_ttfaRunning, 0);
+		return 0;
+	}
+
+	// The prober against the scripted servers, failures included
+	Log("Stand-in server on 127.0.0.1:%u\nHealth probe:\n", g_standin.port);
+	for (int i = 0; i < (int)NUM_STANDIN_PROFILES; i++) {
+		RadioStation* station = StandinStation(i);
+		if (!station) break;
+
+		StationHealth result;
+		ProbeStation(station, &result);
+		int expected = g_standinProfiles[i].health;
+		Log("  %-10s %-4s connect %5u ms, first byte %5u ms  %s\n",
+			   station->name, HealthStatusName(result.status),
+			   result.connectMs, result.firstByteMs,
+			   result.status == expected ? "OK" : "FAIL");
+	}
+
+	// A scripted redirect chain, opened the long way and then from the
+	// connection cache, which goes straight to the last hop's target
+	Log("Redirects:\n");
+	for (int i = 0; i < (int)NUM_STANDIN_PROFILES; i++) {
+		if (strcmp(g_standinProfiles[i].path, "/redirect") != 0) continue;
+		RadioStation* station = StandinStation(i);
+		if (!station) break;
+
+		const DWORD flags = BASS_STREAM_BLOCK | BASS_STREAM_DECODE |
+							BASS_SAMPLE_FLOAT;
+		LARGE_INTEGER start;
+		QueryPerformanceCounter(&start);
+		HSTREAM stream = BASS_StreamCreateURL(station->streamUrl, 0, flags,
+											  NULL, 0);
+		double chainMs = GetElapsedSeconds(start) * 1000.0;
+		if (stream) BASS_StreamFree(stream);
+
+		ConnCacheEntry entry;
+		if (!ResolveStreamUrl(station->streamUrl, &entry)) {
+			Log("  %-10s resolve failed  FAIL\n", station->name);
+			break;
+		}
+		ConnCacheStore(&entry);
+		QueryPerformanceCounter(&start);
+		stream = OpenStationStream(station, flags, NULL, 0);
+		double cachedMs = GetElapsedSeconds(start) * 1000.0;
+		if (stream) BASS_StreamFree(stream);
+
+		Log("  %-10s %u hops resolved in %u ms; open %.0f ms via the chain, "
+			   "%.0f ms via the cache  %s\n", station->name, entry.hops,
+			   entry.resolveMs, chainMs, cachedMs,
+			   stream && cachedMs < chainMs ? "OK" : "FAIL");
+
+		// Not worth keeping: the port changes with every run
+		ConnCacheForget(station->streamUrl);
+	}
+
+	// Each playable profile in turn: the UI thread tunes it as the dial
+	// would (connect worker, mixer, supervisor) and CheckFirstAudio
+	// reports the latency; then it plays for a while to cost it and to
+	// see what the supervisor makes of the server's script
+	Log("Time to first audio:\n");
+	for (int i = 0; i < (int)NUM_STANDIN_PROFILES; i++) {
+		const StandinProfile* script = &g_standinProfiles[i];
+		if (script->health == HEALTH_DEAD || script->location) continue;
+
+		RadioStation* station = StandinStation(i);
+		if (!station) {
+			Log("  no directory slot left for the stand-in stations\n");
+			break;
+		}
+
+		LONG connections = g_standin.connections;
+		LONG underruns = g_mixer.underruns;
+		DWORD reconnects = g_supervisor.reconnects;
+		ResetEvent(g_ttfaHeard);
+		PostMessage(g_connect.notify, WM_TTFA_TUNE, 0, (LPARAM)station);
+		DWORD heard = WaitForSingleObject(g_ttfaHeard, TTFA_TIMEOUT_MS);
+		if (heard != WAIT_OBJECT_0) {
+			Log("  %-10s no audio\n", station->name);
+			PostMessage(g_connect.notify, WM_TTFA_TUNE, 0, 0);
+			continue;
+		}
+
+		float ms = g_ttfaHeardMs;
+		LatencyRecord(&history, ms);
+
+		// Whole process: decode, mixer, static and UI together
+		double cpuStart = GetProcessCpuSeconds();
+		Sleep(TTFA_PLAY_SECONDS * 1000);
+		double cpu = (GetProcessCpuSeconds() - cpuStart) / TTFA_PLAY_SECONDS;
+
+		reconnects = g_supervisor.reconnects - reconnects;
+		Log("  %-10s %5.0f ms, %.1f ms CPU/s, %ld connects, %lu reconnects, "
+			   "%ld underruns\n", station->name, ms, cpu * 1000.0,
+			   g_standin.connections - connections, reconnects,
+			   g_mixer.underruns - underruns);
+
+		// A server scripted to drop must have been noticed and recovered
+		if ((script->dropAfterMs || script->stallAfterMs) && reconnects == 0) {
+			Log("  %-10s FAIL: the drop was never detected\n", "");
+		}
+		PostMessage(g_connect.notify, WM_TTFA_TUNE, 0, 0);
+	}
+
+	Log("  p50 %.0f ms, p99 %.0f ms over %d stations\n",
+		   LatencyPercentile(&history, 50.0f),
+		   LatencyPercentile(&history, 99.0f), history.count);
+
+	StandinStop();
+	InterlockedExchange(&g_ttfaRunning, 0);
+	return 0;
+}
+
+int StandinStart() {
+	WSADATA wsa;
+	if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) return 0;
+
+	g_standin.quit = 0;
+	g_standin.active = 0;
+	g_standin.connections = 0;
+	g_standin.listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+
+	// Loopback only, on whatever port is free
+	struct sockaddr_in address;
+	int size = sizeof(address);
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	SOCKET listener = g_standin.listener;
+	struct sockaddr* bound = (struct sockaddr*)&address;
+	if (listener == INVALID_SOCKET ||
+		bind(listener, bound, sizeof(address)) != 0 ||
+		listen(listener, SOMAXCONN) != 0 ||
+		getsockname(listener, bound, &size) != 0) {
+		Log("Stand-in server: cannot listen (%d)\n", WSAGetLastError());
+		if (listener != INVALID_SOCKET) closesocket(listener);
+		WSACleanup();
+		return 0;
+	}
+	g_standin.port = ntohs(address.sin_port);
+
+	g_standin.thread = CreateThread(NULL, 0, StandinServerProc, NULL, 0, NULL);
+	if (!g_standin.thread) {
+		closesocket(g_standin.listener);
+		WSACleanup();
+		return 0;
+	}
+	Log("Stand-in server listening on 127.0.0.1:%u\n", g_standin.port);
+	return 1;
+}
+
+void StandinStop() {
+	if (!g_standin.thread) return;
+
+	// Closing the listener ends the accept; each connection notices the
+	// flag within a tick, or a send timeout if the client stopped reading
+	InterlockedExchange(&g_standin.quit, 1);
+	closesocket(g_standin.listener);
+	WaitForSingleObject(g_standin.thread, INFINITE);
+	CloseHandle(g_standin.thread);
+	g_standin.thread = NULL;
+	while (g_standin.active > 0) {
+		Sleep(STANDIN_TICK_MS);
+	}
+
+	WSACleanup();
+	Log("Stand-in server stopped after %ld connections\n",
+		g_standin.connections);
+}
+
+RadioStation* StandinStation(int profile) {
+	int slot = g_stationCount + profile;
+	if (slot >= STATION_DIRECTORY_MAX) return NULL;
+
+	RadioStation* station = &g_stations[slot];
+	memset(station, 0, sizeof(RadioStation));
+	sprintf(g_standin.urls[profile], "http://127.0.0.1:%u%s", g_standin.port,
+			g_standinProfiles[profile].path);
+	station->name = g_standinProfiles[profile].path + 1;
+	station->description = "Stand-in server";
+	station->streamUrl = g_standin.urls[profile];
+	station->power = 1.0f;
+
+	// Nothing carried over from an earlier run
+	StationHealth unknown = {};
+	StoreStationHealth(station, &unknown);
+	memset(&g_bufferProfiles[slot], 0, sizeof(BufferProfile));
+	memset(&g_prefetchRetry[slot], 0, sizeof(PrefetchRetry));
+	return station;
+}
+
+DWORD WINAPI StandinServerProc(LPVOID param) {
+	while (!g_standin.quit) {
+		SOCKET client = accept(g_standin.listener, NULL, NULL);
+		if (client == INVALID_SOCKET) break;  // closed by StandinStop
+
+		// One thread per connection; the prober opens several at once
+		InterlockedIncrement(&g_standin.active);
+		InterlockedIncrement(&g_standin.connections);
+		HANDLE thread = CreateThread(NULL, 0, StandinConnectionProc,
+									 (LPVOID)client, 0, NULL);
+		if (thread) {
+			CloseHandle(thread);
+		} else {
+			closesocket(client);
+			InterlockedDecrement(&g_standin.active);
+		}
+	}
+	return 0;
+}
+
+DWORD WINAPI StandinConnectionProc(LPVOID param) {
+	SOCKET client = (SOCKET)param;
+	char request[1024];
+	int received = 0;
+
+	DWORD timeout = STANDIN_IO_TIMEOUT_MS;
+	const char* option = (const char*)&timeout;
+	setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, option, sizeof(timeout));
+	setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, option, sizeof(timeout));
+
+	// The request headers; only the path matters
+	while (received < (int)sizeof(request) - 1) {
+		int room = sizeof(request) - 1 - received;
+		int got = recv(client, request + received, room, 0);
+		if (got <= 0) break;
+		received += got;
+		request[received] = '\0';
+		if (strstr(request, "\r\n\r\n")) break;
+	}
+	request[received] = '\0';
+
+	const StandinProfile* profile = StandinFindProfile(request);
+	if (profile) {
+		StandinServe(client, profile);
+	} else {
+		const char* reply = "HTTP/1.0 404 Not Found\r\n"
+							"Content-Length: 0\r\n\r\n";
+		StandinSend(client, reply, (int)strlen(reply));
+	}
+
+	closesocket(client);
+	InterlockedDecrement(&g_standin.active);
+	return 0;
+}
+
+const StandinProfile* StandinFindProfile(const char* request) {
+	if (strncmp(request, "GET ", 4) != 0) return NULL;
+
+	const char* path = request + 4;
+	int length = (int)strcspn(path, " ?\r\n");
+	for (int i = 0; i < (int)NUM_STANDIN_PROFILES; i++) {
+		const char* candidate = g_standinProfiles[i].path;
+		if ((int)strlen(candidate) == length &&
+			strncmp(candidate, path, length) == 0) {
+			return &g_standinProfiles[i];
+		}
+	}
+	return NULL;
+}
+
+void StandinServe(SOCKET client, const StandinProfile* profile) {
+	const DWORD rate = STANDIN_BITRATE * 1000 / 8;  // bytes per second
+	char block[STANDIN_CHUNK];
+	char meta[1 + 16 * 16];
+
+	if (!StandinWait(profile->latencyMs)) return;
+	if (profile->status == 0) return;
+	if (profile->status != 200) {
+		int length = sprintf(block, "HTTP/1.0 %d Scripted\r\n",
+							 profile->status);
+		if (profile->location) {
+			length += sprintf(block + length,
+							  "Location: http://127.0.0.1:%u%s\r\n",
+							  g_standin.port, profile->location);
+		}
+		length += sprintf(block + length, "Content-Length: 0\r\n\r\n");
+		StandinSend(client, block, length);
+		return;
+	}
+
+	int length = sprintf(block, "HTTP/1.0 200 OK\r\n"
+						 "Content-Type: audio/mpeg\r\n"
+						 "icy-name: Stand-in %s\r\nicy-br: %d\r\n",
+						 profile->path + 1, STANDIN_BITRATE);
+	if (profile->metadata) {
+		length += sprintf(block + length, "icy-metaint: %d\r\n",
+						  STANDIN_META_INTERVAL);
+	}
+	length += sprintf(block + length, "\r\n");
+	if (!StandinSend(client, block, length)) return;
+
+	// A burst up front, then paced against the clock at the profile's rate
+	DWORD start = GetTickCount();
+	DWORD sent = 0;
+	while (!g_standin.quit) {
+		DWORD elapsed = GetTickCount() - start;
+		if (profile->dropAfterMs && elapsed >= profile->dropAfterMs) return;
+		if (profile->stallAfterMs && elapsed >= profile->stallAfterMs) {
+			// Silent but connected, until the client gives up
+			while (!g_standin.quit) {
+				int got = recv(client, block, sizeof(block), 0);
+				if (got == 0) return;
+				if (got < 0 && WSAGetLastError() != WSAETIMEDOUT) return;
+			}
+			return;
+		}
+
+		ULONGLONG paced = (ULONGLONG)elapsed * rate * profile->percentRate;
+		DWORD due = rate * STANDIN_BURST_SECONDS + (DWORD)(paced / 100000);
+		if (sent >= due) {
+			Sleep(STANDIN_TICK_MS);
+			continue;
+		}
+
+		DWORD chunk = due - sent;
+		if (chunk > STANDIN_CHUNK) chunk = STANDIN_CHUNK;
+		if (profile->metadata) {
+			DWORD toMeta = STANDIN_META_INTERVAL - sent % STANDIN_META_INTERVAL;
+			if (chunk > toMeta) chunk = toMeta;
+		}
+		StandinFillAudio(block, sent, chunk);
+		if (!StandinSend(client, block, chunk)) return;
+		sent += chunk;
+
+		// Length byte in 16-byte units, then the zero-padded tag
+		if (profile->metadata && sent % STANDIN_META_INTERVAL == 0) {
+			DWORD song = sent / STANDIN_META_INTERVAL / STANDIN_META_BLOCKS + 1;
+			memset(meta, 0, sizeof(meta));
+			int tag = sprintf(meta + 1, "StreamTitle='Stand-in - Song %lu';",
+							  song);
+			meta[0] = (char)((tag + 15) / 16);
+			if (!StandinSend(client, meta, 1 + meta[0] * 16)) return;
+		}
+	}
+}
+
+void StandinFillAudio(char* out, DWORD offset, DWORD count) {
+	// Back-to-back frames of digital silence: a valid header and zeroed
+	// side info, so there is nothing to decode but the frame itself
+	static const unsigned char header[4] = {0xFF, 0xFB, 0x90, 0x44};
+	for (DWORD i = 0; i < count; i++) {
+		DWORD position = (offset + i) % STANDIN_FRAME_BYTES;
+		out[i] = position < 4 ? (char)header[position] : 0;
+	}
+}
+
+int StandinSend(SOCKET client, const char* data, int length) {
+	while (length > 0) {
+		int sent = send(client, data, length, 0);
+		if (sent <= 0) return 0;  // client gone, or stopped reading
+		data += sent;
+		length -= sent;
+	}
+	return 1;
+}
+
+int StandinWait(DWORD ms) {
+	// Sleeps in ticks so a stop doesn't wait out a long script
+	DWORD start = GetTickCount();
+	while (!g_standin.quit && GetTickCount() - start < ms) {
+		Sleep(STANDIN_TICK_MS);
+	}
+	return !g_standin.quit;
+}
+
+int TimeshiftOpen(Timeshift* ts, DWORD seconds, DWORD sampleRate) {
+	char path[MAX_PATH];
+	DWORD length = GetTempPath(MAX_PATH - 32, path);
+	if (length == 0 || length > MAX_PATH - 32) return 0;
+	sprintf(path + length, "shortwave-timeshift-%lu.tmp",
+			GetCurrentProcessId());
+
+	DWORD blocks = seconds * sampleRate / TIMESHIFT_BLOCK_FRAMES;
+	ts->ringFrames = blocks * TIMESHIFT_BLOCK_FRAMES;
+	DWORD bytes = ts->ringFrames * MIXER_CHANNELS * sizeof(short);
+
+	// Deleted when closed; a normal file so its pages are written back
+	// and dropped, keeping RAM flat however long the ring is
+	ts->file = CreateFile(path, GENERIC_READ | GENERIC_WRITE, 0, NULL,
+		CREATE_ALWAYS, FILE_FLAG_DELETE_ON_CLOSE, NULL);
+	if (ts->file == INVALID_HANDLE_VALUE) {
+		Log("Timeshift: cannot create %s\n", path);
+		ts->file = NULL;
+		return 0;
+	}
+
+	ts->mapping = CreateFileMapping(ts->file, NULL, PAGE_READWRITE, 0, bytes,
+									NULL);
+	ts->ring = NULL;
+	if (ts->mapping) {
+		ts->ring = (short*)MapViewOfFile(ts->mapping, FILE_MAP_WRITE, 0, 0,
+										 bytes);
+	}
+	if (!ts->ring) {
+		Log("Timeshift: cannot map %lu MB\n", bytes >> 20);
+		TimeshiftClose(ts);
+		return 0;
+	}
+
+	ts->stagingFill = 0;
+	ts->skipping = 0;
+	ts->stagedBlocks = 0;
+	ts->drainedBlocks = 0;
+	ts->committedBlocks = 0;
+	ts->capturedFrames = 0;
+	ts->dropped = 0;
+	for (int i = 0; i < TIMESHIFT_REPLAY_BLOCKS; i++) ts->replayBlock[i] = -1;
+	ts->replayWanted = -1;
+	ts->replayMisses = 0;
+	ts->paused = 0;
+	ts->shifted = 0;
+	Log("Timeshift: %lu s (%lu MB) at %s\n", seconds, bytes >> 20, path);
+	return 1;
+}
+
+void TimeshiftClose(Timeshift* ts) {
+	if (ts->thread) {
+		InterlockedExchange(&ts->quit, 1);
+		SetEvent(ts->wake);
+
+		// A writer held up by a page fault on a slow disk may still touch
+		// the view and the event; close only what it never uses and leave
+		// those two, and the mapping behind the view, to the process exit
+		DWORD exited = WaitForSingleObject(ts->thread, TIMESHIFT_EXIT_MS);
+		if (exited != WAIT_OBJECT_0) {
+			Log("Timeshift thread still busy after %lu ms, leaking its view\n",
+				(DWORD)TIMESHIFT_EXIT_MS);
+			CloseHandle(ts->thread);
+			if (ts->file) CloseHandle(ts->file);
+			ts->thread = NULL;
+			ts->wake = NULL;
+			ts->ring = NULL;
+			ts->mapping = NULL;
+			ts->file = NULL;
+			return;
+		}
+		CloseHandle(ts->thread);
+		CloseHandle(ts->wake);
+		ts->thread = NULL;
+		ts->wake = NULL;
+	}
+	if (ts->ring) UnmapViewOfFile(ts->ring);
+	if (ts->mapping) CloseHandle(ts->mapping);
+	if (ts->file) CloseHandle(ts->file);
+	ts->ring = NULL;
+	ts->mapping = NULL;
+	ts->file = NULL;
+}
+
+int TimeshiftStartWriter(Timeshift* ts) {
+	ts->quit = 0;
+	ts->wake = CreateEvent(NULL, FALSE, FALSE, NULL);
+	ts->thread = NULL;
+	if (ts->wake) {
+		ts->thread = CreateThread(NULL, 0, TimeshiftWriterProc, ts, 0, NULL);
+	}
+	if (!ts->thread) {
+		Log("Failed to create timeshift thread\n");
+		return 0;
+	}
+
+	// Below the mixer, above the UI
+	SetThreadPriority(ts->thread, THREAD_PRIORITY_ABOVE_NORMAL);
+	return 1;
+}
+
+DWORD WINAPI TimeshiftWriterProc(LPVOID param) {
+	Timeshift* ts = (Timeshift*)param;
+	while (!ts->quit) {
+		WaitForSingleObject(ts->wake, 100);
+		TimeshiftDrain(ts);
+		TimeshiftLoadReplay(ts);
+	}
+	return 0;
+}
+
+void TimeshiftDrain(Timeshift* ts) {
+	// Whole blocks only, always at the ring's write head
+	DWORD ringBlocks = ts->ringFrames / TIMESHIFT_BLOCK_FRAMES;
+	while (ts->drainedBlocks != ts->stagedBlocks) {
+		DWORD slot = (DWORD)ts->drainedBlocks % TIMESHIFT_STAGING_BLOCKS;
+		DWORD block = ts->stagingBlock[slot];
+		short* dest = ts->ring + (block % ringBlocks) * TIMESHIFT_BLOCK_SAMPLES;
+		memcpy(dest, ts->staging[slot], sizeof(ts->staging[slot]));
+
+		// Start the write-back now so dirty pages never pile up
+		FlushViewOfFile(dest, sizeof(ts->staging[slot]));
+
+		InterlockedExchange(&ts->committedBlocks, (LONG)(block + 1));
+		InterlockedIncrement(&ts->drainedBlocks);
+	}
+}
+
+void TimeshiftLoadReplay(Timeshift* ts) {
+	LONG wanted = ts->replayWanted;
+	if (wanted < 0) return;
+
+	// Committed blocks only; the slot is marked while it is rewritten
+	DWORD ringBlocks = ts->ringFrames / TIMESHIFT_BLOCK_FRAMES;
+	LONG committed = ts->committedBlocks;
+	LONG end = wanted + TIMESHIFT_REPLAY_BLOCKS;
+	if (end > committed) end = committed;
+	for (LONG block = wanted; block < end; block++) {
+		DWORD slot = (DWORD)block % TIMESHIFT_REPLAY_BLOCKS;
+		if (ts->replayBlock[slot] == block) continue;
+
+		InterlockedExchange(&ts->replayBlock[slot], -1);
+		DWORD ringBlock = (DWORD)block % ringBlocks;
+		memcpy(ts->replay[slot], ts->ring + ringBlock * TIMESHIFT_BLOCK_SAMPLES,
+			   sizeof(ts->replay[slot]));
+		InterlockedExchange(&ts->replayBlock[slot], block);
+	}
+}
+
+void TimeshiftWant(Timeshift* ts, ULONGLONG frame) {
+	// Wake the writer as soon as the cursor moves to another block
+	LONG block = (LONG)(frame / TIMESHIFT_BLOCK_FRAMES);
+	if (ts->replayWanted == block) return;
+	InterlockedExchange(&ts->replayWanted, block);
+	if (ts->wake) SetEvent(ts->wake);
+}
+
+void TimeshiftCapture(Timeshift* ts, const float* samples, DWORD frames) {
+	if (!ts->ring) return;
+
+	DWORD done = 0;
+	while (done < frames) {
+		DWORD slot = (DWORD)ts->stagedBlocks % TIMESHIFT_STAGING_BLOCKS;
+		if (ts->stagingFill == 0) {
+			// Writer a whole staging ring behind: drop the block, never wait
+			ts->skipping = ts->stagedBlocks - ts->drainedBlocks >=
+						   TIMESHIFT_STAGING_BLOCKS;
+			if (ts->skipping) {
+				ts->dropped++;
+			} else {
+				ts->stagingBlock[slot] =
+					(DWORD)(ts->capturedFrames / TIMESHIFT_BLOCK_FRAMES);
+			}
+		}
+
+		DWORD count = TIMESHIFT_BLOCK_FRAMES - ts->stagingFill;
+		if (count > frames - done) count = frames - done;
+
+		if (!ts->skipping) {
+			short* dest = ts->staging[slot] + ts->stagingFill * MIXER_CHANNELS;
+			const float* src = samples + done * MIXER_CHANNELS;
+			for (DWORD i = 0; i < count * MIXER_CHANNELS; i++) {
+				float value = src[i] * 32767.0f;
+				if (value > 32767.0f) value = 32767.0f;
+				if (value < -32768.0f) value = -32768.0f;
+				dest[i] = (short)value;
+			}
+		}
+
+		ts->stagingFill += count;
+		ts->capturedFrames += count;
+		done += count;
+
+		if (ts->stagingFill == TIMESHIFT_BLOCK_FRAMES) {
+			ts->stagingFill = 0;
+			if (!ts->skipping) {
+				InterlockedIncrement(&ts->stagedBlocks);
+				if (ts->wake) SetEvent(ts->wake);
+			}
+		}
+	}
+}
+
+void TimeshiftReplay(Timeshift* ts, float* samples, DWORD frames) {
+	if (!ts->ring) return;
+	if (!ts->shifted) {
+		if (ts->replayWanted >= 0) InterlockedExchange(&ts->replayWanted, -1);
+		return;
+	}
+
+	ULONGLONG committed = (ULONGLONG)(DWORD)ts->committedBlocks *
+						  TIMESHIFT_BLOCK_FRAMES;
+	ULONGLONG oldest = 0;
+	if (committed > ts->ringFrames) oldest = committed - ts->ringFrames;
+	if (ts->playFrame < oldest) ts->playFrame = oldest;
+
+	// Paused keeps the blocks ahead loaded for the resume
+	TimeshiftWant(ts, ts->playFrame);
+	if (ts->paused) return;
+
+	// Caught up with what the writer has committed: back to live
+	if (ts->playFrame + frames > committed) {
+		ts->shifted = 0;
+		Log("Timeshift: live\n");
+		return;
+	}
+
+	// A run never crosses a block, so it sits whole in one slot and
+	// contiguous in the mapping
+	DWORD done = 0;
+	while (done < frames) {
+		LONG block = (LONG)(ts->playFrame / TIMESHIFT_BLOCK_FRAMES);
+		DWORD offset = (DWORD)(ts->playFrame % TIMESHIFT_BLOCK_FRAMES);
+		DWORD count = TIMESHIFT_BLOCK_FRAMES - offset;
+		if (count > frames - done) count = frames - done;
+
+		DWORD slot = (DWORD)block % TIMESHIFT_REPLAY_BLOCKS;
+		DWORD ringFrame = (DWORD)(ts->playFrame % ts->ringFrames);
+		const short* mapped = ts->ring + ringFrame * MIXER_CHANNELS;
+		float* out = samples + done * MIXER_CHANNELS;
+		if (ts->replayBlock[slot] == block) {
+			TimeshiftReplayRun(ts->replay[slot] + offset * MIXER_CHANNELS, out,
+							   count);
+			// Reloaded under us after a jump: the mapping has it too
+			if (ts->replayBlock[slot] != block) {
+				TimeshiftReplayRun(mapped, out, count);
+				ts->replayMisses++;
+			}
+		} else {
+			// Only just after a rewind, before the writer has caught up
+			TimeshiftReplayRun(mapped, out, count);
+			ts->replayMisses++;
+		}
+
+		ts->playFrame += count;
+		done += count;
+	}
+}
+
+void TimeshiftReplayRun(const short* src, float* samples, DWORD frames) {
+	for (DWORD i = 0; i < frames * MIXER_CHANNELS; i++) {
+		samples[i] = src[i] * (1.0f / 32768.0f);
+	}
+}
+
+void TimeshiftPause() {
+	if (!g_timeshift.ring || !g_audio.outputStream) return;
+
+	BASS_ChannelLock(g_audio.outputStream, TRUE);
+	if (g_timeshift.paused) {
+		g_timeshift.paused = 0;
+	} else {
+		// Resume exactly where we stopped listening
+		if (!g_timeshift.shifted) {
+			g_timeshift.playFrame = g_timeshift.capturedFrames;
+			g_timeshift.shifted = 1;
+		}
+		g_timeshift.paused = 1;
+		TimeshiftWant(&g_timeshift, g_timeshift.playFrame);
+	}
+	int paused = g_timeshift.paused;
+	BASS_ChannelLock(g_audio.outputStream, FALSE);
+
+	Log("Timeshift: %s\n", paused ? "paused" : "resumed");
+}
+
+void TimeshiftRewind(DWORD seconds) {
+	if (!g_timeshift.ring || !g_audio.outputStream) return;
+
+	BASS_ChannelLock(g_audio.outputStream, TRUE);
+	if (!g_timeshift.shifted) {
+		g_timeshift.playFrame = g_timeshift.capturedFrames;
+		g_timeshift.shifted = 1;
+	}
+	// Replay clamps to the oldest frame still in the ring
+	ULONGLONG back = (ULONGLONG)seconds * g_sampleRate;
+	ULONGLONG playFrame = g_timeshift.playFrame;
+	g_timeshift.playFrame = playFrame > back ? playFrame - back : 0;
+	DWORD behind = (DWORD)(g_timeshift.capturedFrames - g_timeshift.playFrame);
+	TimeshiftWant(&g_timeshift, g_timeshift.playFrame);
+	BASS_ChannelLock(g_audio.outputStream, FALSE);
+
+	Log("Timeshift: %.1f s behind live\n", (float)behind / g_sampleRate);
+}
+
+void TimeshiftGoLive() {
+	if (!g_audio.outputStream) return;
+
+	BASS_ChannelLock(g_audio.outputStream, TRUE);
+	g_timeshift.paused = 0;
+	g_timeshift.shifted = 0;
+	BASS_ChannelLock(g_audio.outputStream, FALSE);
+
+	Log("Timeshift: live\n");
+}
+
+DWORD HashStationUrl(const char* url) {
+	DWORD hash = 2166136261u;
+	while (*url) {
+		hash = (hash ^ (BYTE)*url++) * 16777619u;
+	}
+	return hash;
+}
+
+StationHealth* GetStationHealth(RadioStation* station) {
+	return &g_stationHealth[station - g_stations];
+}
+
+void ReadStationHealth(RadioStation* station, StationHealth* health) {
+	// Probe threads replace records while the UI thread reads them; a
+	// torn copy could pair one probe's status with another's time
+	EnterCriticalSection(&g_prober.lock);
+	*health = *GetStationHealth(station);
+	LeaveCriticalSection(&g_prober.lock);
+}
+
+void StoreStationHealth(RadioStation* station, const StationHealth* health) {
+	EnterCriticalSection(&g_prober.lock);
+	*GetStationHealth(station) = *health;
+	LeaveCriticalSection(&g_prober.lock);
+}
+
+int IsStationOffAir(RadioStation* station) {
+	StationHealth health;
+	ReadStationHealth(station, &health);
+	return health.status == HEALTH_DEAD &&
+		   (DWORD)time(NULL) - health.checked < HEALTH_DEAD_AGE;
+}
+
+const char* HealthErrorName(int error) {
+	switch (error) {
+		case BASS_ERROR_FILEOPEN: return "cannot connect";
+		case BASS_ERROR_FORMAT: return "unsupported format";
+		case BASS_ERROR_SSL: return "no HTTPS support";
+		case BASS_ERROR_NONET: return "no network";
+		case BASS_ERROR_TIMEOUT: return "timed out";
+		case BASS_ERROR_FILEFORM: return "not audio";
+		case BASS_ERROR_CODEC: return "no codec";
+		case BASS_ERROR_PROTOCOL: return "bad protocol";
+		default: return "error";
+	}
+}
+
+const char* HealthStatusName(int status) {
+	switch (status) {
+		case HEALTH_OK: return "ok";
+		case HEALTH_SLOW: return "slow";
+		case HEALTH_DEAD: return "dead";
+		default: return "unknown";
+	}
+}
+
+const char* HealthCodecName(DWORD ctype) {
+	if (ctype & BASS_CTYPE_STREAM_WAV) return "WAV";
+	switch (ctype) {
+		case BASS_CTYPE_STREAM_OGG: return "OGG";
+		case BASS_CTYPE_STREAM_MP1: return "MP1";
+		case BASS_CTYPE_STREAM_MP2: return "MP2";
+		case BASS_CTYPE_STREAM_MP3: return "MP3";
+		case BASS_CTYPE_STREAM_AIFF: return "AIFF";
+		case 0: return "-";
+		default: return "other";
+	}
+}
+
+void CALLBACK ProbeDownloadProc(const void* buffer, DWORD length, void* user) {
+	// With BASS_STREAM_STATUS the response headers arrive with no length,
+	// then the body in blocks
+	ProbeTiming* timing = (ProbeTiming*)user;
+	if (!buffer) return;
+
+	float ms = (float)(GetElapsedSeconds(timing->start) * 1000.0);
+	if (length == 0 && timing->connectMs == 0.0f) timing->connectMs = ms;
+	if (length > 0 && timing->firstByteMs == 0.0f) timing->firstByteMs = ms;
+}
+
+int ProbeStation(RadioStation* station, StationHealth* health) {
+	ProbeTiming timing = {};
+	QueryPerformanceCounter(&timing.start);
+
+	HSTREAM stream = OpenStationStream(station,
+		BASS_STREAM_BLOCK | BASS_STREAM_DECODE | BASS_STREAM_STATUS |
+		BASS_SAMPLE_FLOAT, ProbeDownloadProc, &timing);
+	float totalMs = (float)(GetElapsedSeconds(timing.start) * 1000.0);
+	int error = stream ? 0 : BASS_ErrorGetCode();
+
+	StationHealth result = {};
+	result.urlHash = HashStationUrl(station->streamUrl);
+	result.checked = (DWORD)time(NULL);
+
+	// A server that never answered still took this long to fail
+	float firstByteMs = timing.firstByteMs > 0.0f ? timing.firstByteMs
+												  : totalMs;
+	float connectMs = timing.connectMs > 0.0f ? timing.connectMs : firstByteMs;
+	result.connectMs = (WORD)(connectMs < 65535.0f ? connectMs : 65535.0f);
+	result.firstByteMs = (WORD)(firstByteMs < 65535.0f ? firstByteMs
+													   : 65535.0f);
+
+	if (stream) {
+		BASS_CHANNELINFO info;
+		float bitrate = 0.0f;
+		if (BASS_ChannelGetInfo(stream, &info)) result.ctype = info.ctype;
+		BASS_ChannelGetAttribute(stream, BASS_ATTRIB_BITRATE, &bitrate);
+		result.bitrate = (WORD)bitrate;
+		result.status = firstByteMs > HEALTH_SLOW_MS ? HEALTH_SLOW : HEALTH_OK;
+		BASS_StreamFree(stream);
+	} else {
+		result.status = HEALTH_DEAD;
+		result.error = (BYTE)(error > 0 && error < 255 ? error : 255);
+	}
+
+	*health = result;
+	return result.status != HEALTH_DEAD;
+}
+
+DWORD WINAPI HealthProbeProc(LPVOID param) {
+	// Threads claim stations one at a time until the directory runs out
+	while (!g_prober.quit) {
+		LONG index = InterlockedIncrement(&g_prober.next) - 1;
+		if (index >= g_stationCount) break;
+
+		RadioStation* station = &g_stations[index];
+		// Dead stations get another look once they stop blocking the tuner
+		StationHealth* health = GetStationHealth(station);
+		DWORD maxAge = health->status == HEALTH_DEAD ? HEALTH_DEAD_AGE
+													 : HEALTH_MAX_AGE;
+		if (!g_prober.force && health->status != HEALTH_UNKNOWN &&
+			(DWORD)time(NULL) - health->checked < maxAge) {
+			continue;
+		}
+
+		// Walk the redirect chain first so the probe checks the target
+		// tuning will actually use
+		if (!ConnCacheIsFresh(station->streamUrl)) {
+			ConnCacheEntry entry;
+			if (ResolveStreamUrl(station->streamUrl, &entry)) {
+				ConnCacheStore(&entry);
+				if (entry.hops) {
+					Log("Resolved %s: %u hops in %u ms to %s (%s)\n",
+						   station->name, entry.hops, entry.resolveMs,
+						   entry.finalUrl, entry.address);
+				}
+			}
+		}
+
+		StationHealth result;
+		ProbeStation(station, &result);
+		StoreStationHealth(station, &result);
+		InterlockedIncrement(&g_prober.probed);
+
+		if (result.status == HEALTH_DEAD) {
+			Log("Probe: %-20s dead after %u ms (%s, BASS Error: %u)\n",
+				   station->name, result.connectMs,
+				   HealthErrorName(result.error), result.error);
+		} else {
+			Log("Probe: %-20s %s, connect %u ms, first byte %u ms, "
+				"%u kbps %s\n", station->name,
+				   result.status == HEALTH_SLOW ? "slow" : "ok",
+				   result.connectMs, result.firstByteMs, result.bitrate,
+				   HealthCodecName(result.ctype));
+		}
+	}
+
+	// The last thread out writes the batch to disk
+	if (InterlockedDecrement(&g_prober.active) == 0) {
+		Log("Probe: %ld stations checked\n", g_prober.probed);
+		if (g_prober.probed) SaveHealthCache();
+		SaveConnCache();
+	}
+	return 0;
+}
+
+int StartHealthProbe(int force) {
+	if (g_prober.active) return 0;
+	if (g_stationCount == 0) return 1;
+
+	for (int i = 0; i < PROBE_THREADS; i++) {
+		if (g_prober.threads[i]) CloseHandle(g_prober.threads[i]);
+		g_prober.threads[i] = NULL;
+	}
+
+	g_prober.next = 0;
+	g_prober.quit = 0;
+	g_prober.force = force;
+	g_prober.probed = 0;
+	g_prober.active = PROBE_THREADS;
+	for (int i = 0; i < PROBE_THREADS; i++) {
+		g_prober.threads[i] = CreateThread(NULL, 0, HealthProbeProc, NULL,
+										   CREATE_SUSPENDED, NULL);
+		if (!g_prober.threads[i]) {
+			Log("Failed to create probe thread\n");
+			InterlockedDecrement(&g_prober.active);
+			continue;
+		}
+
+		// Never compete with the audio or the UI
+		SetThreadPriority(g_prober.threads[i], THREAD_PRIORITY_LOWEST);
+		ResumeThread(g_prober.threads[i]);
+	}
+	return 1;
+}
+
+void StopHealthProbe() {
+	// Each thread finishes the station it is on. A resolve can take a
+	// timeout per hop, so closing the WinINet session fails it at once;
+	// that leaves at most an open, which the net worker wait bounds
+	InterlockedExchange(&g_prober.quit, 1);
+	if (g_prober.active > 0) {
+		HINTERNET internet = InterlockedExchangePointer(&g_connCache.internet,
+														NULL);
+		if (internet) InternetCloseHandle(internet);
+	}
+	for (int i = 0; i < PROBE_THREADS; i++) {
+		if (!g_prober.threads[i]) continue;
+		WaitForNetWorker(g_prober.threads[i], "Probe");
+		CloseHandle(g_prober.threads[i]);
+		g_prober.threads[i] = NULL;
+	}
+}
+
+int CompareHealth(const void* a, const void* b) {
+	DWORD ha = ((const StationHealth*)a)->urlHash;
+	DWORD hb = ((const StationHealth*)b)->urlHash;
+	return ha < hb ? -1 : ha > hb ? 1 : 0;
+}
+
+int LoadHealthCache() {
+	static StationHealth records[STATION_DIRECTORY_MAX];
+	char path[MAX_PATH];
+	if (!GetAppFilePath(HEALTH_CACHE_FILE, path)) return 0;
+
+	FILE* file = fopen(path, "rb");
+	if (!file) return 0;
+
+	DWORD header[3];
+	int count = 0;
+	if (fread(header, sizeof(header), 1, file) == 1 &&
+		header[0] == HEALTH_CACHE_MAGIC &&
+		header[1] == HEALTH_CACHE_VERSION &&
+		header[2] <= STATION_DIRECTORY_MAX) {
+		count = (int)fread(records, sizeof(StationHealth), header[2], file);
+	}
+	fclose(file);
+
+	// Matched by URL, so editing stations.txt keeps the results it can
+	qsort(records, count, sizeof(StationHealth), CompareHealth);
+	int matched = 0;
+	for (int i = 0; i < g_stationCount; i++) {
+		StationHealth key;
+		key.urlHash = HashStationUrl(g_stations[i].streamUrl);
+		StationHealth* found = (StationHealth*)bsearch(&key, records, count,
+			sizeof(StationHealth), CompareHealth);
+		if (found) {
+			g_stationHealth[i] = *found;
+			matched++;
+		}
+	}
+
+	Log("Health cache: %d of %d stations known\n", matched, g_stationCount);
+	return matched;
+}
+
+int SaveHealthCache() {
+	char path[MAX_PATH];
+	if (!GetAppFilePath(HEALTH_CACHE_FILE, path)) return 0;
+
+	FILE* file = fopen(path, "wb");
+	if (!file) {
+		Log("Cannot write %s\n", path);
+		return 0;
+	}
+
+	DWORD count = 0;
+	for (int i = 0; i < g_stationCount; i++) {
+		if (g_stationHealth[i].status != HEALTH_UNKNOWN) count++;
+	}
+
+	DWORD header[3] = {HEALTH_CACHE_MAGIC, HEALTH_CACHE_VERSION, count};
+	int ok = fwrite(header, sizeof(header), 1, file) == 1;
+	for (int i = 0; i < g_stationCount && ok; i++) {
+		if (g_stationHealth[i].status == HEALTH_UNKNOWN) continue;
+		ok = fwrite(&g_stationHealth[i], sizeof(StationHealth), 1, file) == 1;
+	}
+	ok = fclose(file) == 0 && ok;
+
+	if (!ok) Log("Failed writing %s\n", path);
+	return ok;
+}
+
+int InitConnCache() {
+	InitializeCriticalSection(&g_connCache.lock);
+
+	// For the address lookups only; streams still connect through BASS
+	WSADATA wsa;
+	if (WSAStartup(MAKEWORD(1, 1), &wsa) != 0) {
+		Log("WSAStartup failed; server addresses won't be recorded\n");
+	}
+
+	g_connCache.internet = InternetOpen("Shortwave",
+		INTERNET_OPEN_TYPE_PRECONFIG, NULL, NULL, 0);
+	if (!g_connCache.internet) {
+		Log("InternetOpen failed (%lu); connection cache disabled\n",
+			GetLastError());
+		return 0;
+	}
+
+	// Each hop of a resolve gives up when a BASS connect would, rather
+	// than on WinINet's much longer defaults
+	DWORD timeout = BASS_GetConfig(BASS_CONFIG_NET_TIMEOUT);
+	InternetSetOption(g_connCache.internet, INTERNET_OPTION_CONNECT_TIMEOUT,
+					  &timeout, sizeof(timeout));
+	InternetSetOption(g_connCache.internet, INTERNET_OPTION_RECEIVE_TIMEOUT,
+					  &timeout, sizeof(timeout));
+	return 1;
+}
+
+void CleanupConnCache() {
+	if (g_connCache.dirty) SaveConnCache();
+	if (g_connCache.internet) InternetCloseHandle(g_connCache.internet);
+	g_connCache.internet = NULL;
+	WSACleanup();
+	DeleteCriticalSection(&g_connCache.lock);
+}
+
+ConnCacheEntry* ConnCacheFind(DWORD urlHash) {
+	// Open addressing; callers hold the lock
+	for (int probe = 0; probe < CONN_CACHE_SIZE; probe++) {
+		DWORD index = (urlHash + probe) % CONN_CACHE_SIZE;
+		ConnCacheEntry* entry = &g_connCache.entries[index];
+		if (entry->urlHash == urlHash) return entry;
+		if (entry->urlHash == 0) return NULL;
+	}
+	return NULL;
+}
+
+int ConnCacheLookup(const char* url, char* target, int* hops) {
+	int found = 0;
+	EnterCriticalSection(&g_connCache.lock);
+	ConnCacheEntry* entry = ConnCacheFind(HashStationUrl(url));
+	if (entry && entry->hops &&
+		(DWORD)time(NULL) - entry->resolved < entry->ttl) {
+		strcpy(target, entry->finalUrl);
+		*hops = entry->hops;
+		found = 1;
+	}
+	LeaveCriticalSection(&g_connCache.lock);
+	return found;
+}
+
+int ConnCacheIsFresh(const char* url) {
+	EnterCriticalSection(&g_connCache.lock);
+	ConnCacheEntry* entry = ConnCacheFind(HashStationUrl(url));
+	int fresh = entry && (DWORD)time(NULL) - entry->resolved < entry->ttl;
+	LeaveCriticalSection(&g_connCache.lock);
+	return fresh;
+}
+
+void ConnCacheStore(const ConnCacheEntry* entry) {
+	EnterCriticalSection(&g_connCache.lock);
+	ConnCacheEntry* slot = ConnCacheFind(entry->urlHash);
+	if (!slot) {
+		// First free slot on the probe path, else the stalest entry on it
+		DWORD now = (DWORD)time(NULL);
+		DWORD worst = 0;
+		for (int probe = 0; probe < CONN_CACHE_SIZE; probe++) {
+			DWORD index = (entry->urlHash + probe) % CONN_CACHE_SIZE;
+			ConnCacheEntry* candidate = &g_connCache.entries[index];
+			if (candidate->urlHash == 0) {
+				slot = candidate;
+				break;
+			}
+			DWORD age = now - candidate->resolved;
+			if (probe < 8 && age >= worst) {
+				worst = age;
+				slot = candidate;
+			}
+		}
+	}
+	*slot = *entry;
+	g_connCache.dirty = 1;
+	LeaveCriticalSection(&g_connCache.lock);
+}
+
+void ConnCacheForget(const char* url) {
+	// Expire rather than clear, so the probe chains of other entries stay
+	// intact; the prober resolves it again on its next pass
+	EnterCriticalSection(&g_connCache.lock);
+	ConnCacheEntry* entry = ConnCacheFind(HashStationUrl(url));
+	if (entry) {
+		entry->ttl = 0;
+		g_connCache.dirty = 1;
+	}
+	LeaveCriticalSection(&g_connCache.lock);
+}
+
+int ResolveStreamUrl(const char* url, ConnCacheEntry* entry) {
+	if (!g_connCache.internet || strlen(url) >= CONN_URL_SIZE) return 0;
+
+	LARGE_INTEGER start;
+	QueryPerformanceCounter(&start);
+	memset(entry, 0, sizeof(ConnCacheEntry));
+	strcpy(entry->finalUrl, url);
+	entry->ttl = CONN_TTL_PERMANENT;
+
+	// Follow the chain by hand: redirects off, one hop per request
+	const DWORD flags = INTERNET_FLAG_NO_AUTO_REDIRECT |
+						INTERNET_FLAG_NO_CACHE_WRITE |
+						INTERNET_FLAG_RELOAD | INTERNET_FLAG_NO_UI;
+	for (;;) {
+		HINTERNET request = InternetOpenUrl(g_connCache.internet,
+											entry->finalUrl, NULL, 0, flags, 0);
+		if (!request) {
+			Log("Resolve %s: cannot open (%lu)\n", entry->finalUrl,
+				GetLastError());
+			return 0;
+		}
+
+		DWORD status = 0;
+		DWORD size = sizeof(status);
+		HttpQueryInfo(request, HTTP_QUERY_STATUS_CODE | HTTP_QUERY_FLAG_NUMBER,
+					  &status, &size, NULL);
+		size = sizeof(entry->contentType);
+		if (!HttpQueryInfo(request, HTTP_QUERY_CONTENT_TYPE,
+						   entry->contentType, &size, NULL)) {
+			entry->contentType[0] = '\0';
+		}
+
+		char next[CONN_URL_SIZE];
+		int hop = 0;
+		int redirect = status == 301 || status == 302 || status == 303 ||
+					   status == 307 || status == 308;
+		int playlist = strstr(entry->contentType, "scpls") ||
+					   strstr(entry->contentType, "mpegurl");
+		if (redirect) {
+			char location[CONN_URL_SIZE];
+			DWORD nextSize = sizeof(next);
+			size = sizeof(location);
+			hop = HttpQueryInfo(request, HTTP_QUERY_LOCATION, location, &size,
+								NULL) &&
+				  InternetCombineUrl(entry->finalUrl, location, next, &nextSize,
+									 ICU_NO_ENCODE);
+			int temporary = status != 301 && status != 308;
+			if (hop && temporary && entry->ttl > CONN_TTL_TEMPORARY) {
+				entry->ttl = CONN_TTL_TEMPORARY;
+			}
+		} else if (playlist) {
+			// Playlists are small; the first stream in one is the target
+			char body[2048];
+			DWORD read = 0;
+			InternetReadFile(request, body, sizeof(body) - 1, &read);
+			body[read] = '\0';
+			hop = ParsePlaylistTarget(body, next, sizeof(next));
+			if (hop && entry->ttl > CONN_TTL_PLAYLIST) {
+				entry->ttl = CONN_TTL_PLAYLIST;
+			}
+		}
+		InternetCloseHandle(request);
+
+		// Anything else, including ICY replies, is the stream itself
+		if (!hop) break;
+		if (++entry->hops > CONN_MAX_HOPS) {
+			Log("Resolve %s: more than %d hops\n", url, CONN_MAX_HOPS);
+			return 0;
+		}
+		strcpy(entry->finalUrl, next);
+	}
+
+	ResolveHostAddress(entry->finalUrl, entry->address);
+	entry->urlHash = HashStationUrl(url);
+	entry->resolved = (DWORD)time(NULL);
+	entry->resolveMs = (WORD)(GetElapsedSeconds(start) * 1000.0);
+	return 1;
+}
+
+int ParsePlaylistTarget(const char* body, char* target, int size) {
+	// .pls: "File1=http://..."; .m3u: the first line that is a URL
+	const char* line = body;
+	while (*line) {
+		const char* value = line;
+		if (strncmp(value, "File", 4) == 0 && strchr(value, '=')) {
+			value = strchr(value, '=') + 1;
+		}
+		if (strncmp(value, "http://", 7) == 0 ||
+			strncmp(value, "https://", 8) == 0) {
+			int length = (int)strcspn(value, "\r\n");
+			if (length >= size) return 0;
+			memcpy(target, value, length);
+			target[length] = '\0';
+			return 1;
+		}
+
+		line += strcspn(line, "\n");
+		if (*line) line++;
+	}
+	return 0;
+}
+
+void ResolveHostAddress(const char* url, char* address) {
+	char host[128];
+	URL_COMPONENTS parts;
+	memset(&parts, 0, sizeof(parts));
+	parts.dwStructSize = sizeof(parts);
+	parts.lpszHostName = host;
+	parts.dwHostNameLength = sizeof(host);
+
+	address[0] = '\0';
+	if (!InternetCrackUrl(url, 0, 0, &parts)) return;
+
+	LONGLONG traceStart = TraceBegin(&g_trace);
+	struct hostent* entry = gethostbyname(host);
+	TraceEnd(&g_trace, "gethostbyname", NULL, traceStart);
+	if (entry && entry->h_addrtype == AF_INET && entry->h_addr_list[0]) {
+		struct in_addr* first = (struct in_addr*)entry->h_addr_list[0];
+		strncpy(address, inet_ntoa(*first), 15);
+		address[15] = '\0';
+	}
+}
+
+HSTREAM OpenStationStream(RadioStation* station, DWORD flags,
+						  DOWNLOADPROC* proc, void* user) {
+	char target[CONN_URL_SIZE];
+	int hops = 0;
+	if (ConnCacheLookup(station->streamUrl, target, &hops)) {
+		LONGLONG traceStart = TraceBegin(&g_trace);
+		HSTREAM stream = BASS_StreamCreateURL(target, 0, flags, proc, user);
+		TraceEnd(&g_trace, "BASS_StreamCreateURL (cached target)", station,
+				 traceStart);
+		if (stream) {
+			Log("Opened %s directly, %d hops skipped\n", station->name, hops);
+			return stream;
+		}
+
+		// The shortcut went stale: forget it and take the long way round
+		Log("Cached target for %s failed (BASS Error: %d), using %s\n",
+			   station->name, BASS_ErrorGetCode(), station->streamUrl);
+		ConnCacheForget(station->streamUrl);
+	}
+
+	// DNS, connect, request and the first data all happen in here
+	LONGLONG traceStart = TraceBegin(&g_trace);
+	HSTREAM stream = BASS_StreamCreateURL(station->streamUrl, 0, flags,
+										  proc, user);
+	TraceEnd(&g_trace, "BASS_StreamCreateURL", station, traceStart);
+	return stream;
+}
+
+int LoadConnCache() {
+	static ConnCacheEntry records[CONN_CACHE_SIZE];
+	char path[MAX_PATH];
+	if (!GetAppFilePath(CONN_CACHE_FILE, path)) return 0;
+
+	FILE* file = fopen(path, "rb");
+	if (!file) return 0;
+
+	DWORD header[3];
+	int count = 0;
+	if (fread(header, sizeof(header), 1, file) == 1 &&
+		header[0] == CONN_CACHE_MAGIC &&
+		header[1] == CONN_CACHE_VERSION &&
+		header[2] <= CONN_CACHE_SIZE) {
+		count = (int)fread(records, sizeof(ConnCacheEntry), header[2], file);
+	}
+	fclose(file);
+
+	for (int i = 0; i < count; i++) {
+		records[i].finalUrl[CONN_URL_SIZE - 1] = '\0';
+		records[i].address[sizeof(records[i].address) - 1] = '\0';
+		records[i].contentType[sizeof(records[i].contentType) - 1] = '\0';
+		if (records[i].urlHash) ConnCacheStore(&records[i]);
+	}
+	g_connCache.dirty = 0;
+
+	Log("Connection cache: %d entries\n", count);
+	return count;
+}
+
+int SaveConnCache() {
+	static ConnCacheEntry records[CONN_CACHE_SIZE];
+	char path[MAX_PATH];
+	if (!GetAppFilePath(CONN_CACHE_FILE, path)) return 0;
+
+	// Only live entries are worth keeping
+	DWORD count = 0;
+	DWORD now = (DWORD)time(NULL);
+	EnterCriticalSection(&g_connCache.lock);
+	for (int i = 0; i < CONN_CACHE_SIZE; i++) {
+		ConnCacheEntry* entry = &g_connCache.entries[i];
+		if (entry->urlHash && now - entry->resolved < entry->ttl) {
+			records[count++] = *entry;
+		}
+	}
+	g_connCache.dirty = 0;
+	LeaveCriticalSection(&g_connCache.lock);
+
+	FILE* file = fopen(path, "wb");
+	if (!file) {
+		Log("Cannot write %s\n", path);
+		return 0;
+	}
+
+	DWORD header[3] = {CONN_CACHE_MAGIC, CONN_CACHE_VERSION, count};
+	int ok = fwrite(header, sizeof(header), 1, file) == 1 &&
+			 fwrite(records, sizeof(ConnCacheEntry), count, file) == count;
+	ok = fclose(file) == 0 && ok;
+
+	if (!ok) Log("Failed writing %s\n", path);
+	return ok;
+}
+
+BufferProfile* GetBufferProfile(RadioStation* station) {
+	return &g_bufferProfiles[station - g_stations];
+}
+
+DWORD BufferStartBytes(BufferProfile* profile, float bytesPerSecond) {
+	// Enough to ride out the link's usual wobble, scaled up by past underruns
+	float relativeJitter = 1.0f;
+	if (profile->throughput > 0.0f) {
+		relativeJitter = profile->jitter / profile->throughput;
+	}
+	float seconds = (BUFFER_BASE_SECONDS +
+					 BUFFER_JITTER_SECONDS * relativeJitter) * profile->margin;
+	if (seconds > BUFFER_MAX_SECONDS) seconds = BUFFER_MAX_SECONDS;
+	float bytes = bytesPerSecond * seconds;
+
+	if (bytes < BUFFER_MIN_START) bytes = BUFFER_MIN_START;
+	if (bytes > BUFFER_MAX_START) bytes = BUFFER_MAX_START;
+	return (DWORD)bytes;
+}
+
+void BufferControllerAttach(HSTREAM stream, RadioStation* station) {
+	BufferProfile* profile = GetBufferProfile(station);
+	if (profile->margin < 1.0f) profile->margin = 1.0f;
+
+	g_buffering.stream = stream;
+	g_buffering.profile = profile;
+	g_buffering.lastReceived = 0;
+	g_buffering.lastAt.QuadPart = 0;
+	g_buffering.tick = 0;
+	g_buffering.lastUnderruns = g_mixer.underruns;
+	g_buffering.closed = 0;
+
+	// A station we have history for starts on its learned threshold
+	if (profile->samples >= BUFFER_MIN_SAMPLES) {
+		g_buffering.startBytes = BufferStartBytes(profile, profile->throughput);
+		g_mixer.minBuffered = g_buffering.startBytes;
+		Log("Buffering %s: start at %lu bytes "
+			"(%.1f kB/s, jitter %.1f kB/s, margin %.2f)\n",
+			   station->name, g_buffering.startBytes,
+			   profile->throughput / 1000.0f, profile->jitter / 1000.0f,
+			   profile->margin);
+	} else {
+		g_buffering.startBytes = MIXER_MIN_BUFFERED;
+	}
+}
+
+void BufferControllerTick() {
+	HSTREAM current = g_audio.currentStream;
+	if (!g_buffering.stream || g_buffering.stream != current) return;
+	if (++g_buffering.tick < BUFFER_SAMPLE_TICKS) return;
+	g_buffering.tick = 0;
+
+	BufferProfile* profile = g_buffering.profile;
+	HSTREAM stream = g_buffering.stream;
+
+	// Bytes received so far: what has been decoded plus what is waiting
+	QWORD decoded = BASS_StreamGetFilePosition(stream, BASS_FILEPOS_CURRENT);
+	QWORD buffered = BASS_StreamGetFilePosition(stream, BASS_FILEPOS_BUFFER);
+	QWORD connected = BASS_StreamGetFilePosition(stream,
+												 BASS_FILEPOS_CONNECTED);
+	if (decoded == (QWORD)-1 || buffered == (QWORD)-1) return;
+	if (connected == 0) {
+		// What is buffered still plays; below a pull's worth the mixer
+		// won't touch it, so the stream is finished
+		if (!g_buffering.closed) {
+			g_buffering.closed = 1;
+			Log("Buffering: connection closed, %lu kB left in the buffer\n",
+				(DWORD)(buffered / 1024));
+		}
+		if (buffered < MIXER_RUN_FLOOR) {
+			SupervisorDrop("connection closed");
+			return;
+		}
+	}
+	QWORD received = decoded + buffered;
+
+	if (g_buffering.lastAt.QuadPart && received >= g_buffering.lastReceived) {
+		float seconds = (float)GetElapsedSeconds(g_buffering.lastAt);
+		QWORD arrived = received - g_buffering.lastReceived;
+		float rate = seconds > 0.0f ? arrived / seconds : 0.0f;
+		if (profile->samples == 0) {
+			profile->throughput = rate;
+			profile->jitter = 0.0f;
+		} else {
+			float deviation = fabs(rate - profile->throughput);
+			profile->jitter += (deviation - profile->jitter) * BUFFER_SMOOTHING;
+			profile->throughput += (rate - profile->throughput) *
+								   BUFFER_SMOOTHING;
+		}
+		profile->samples++;
+	}
+	g_buffering.lastReceived = received;
+	QueryPerformanceCounter(&g_buffering.lastAt);
+
+	// An underrun means we started too early for this link
+	LONG underruns = g_mixer.underruns;
+	if (underruns != g_buffering.lastUnderruns) {
+		profile->margin *= 1.5f;
+		if (profile->margin > BUFFER_MAX_MARGIN) {
+			profile->margin = BUFFER_MAX_MARGIN;
+		}
+		Log("Buffering: underrun (%ld total), margin now %.2f\n", underruns,
+			profile->margin);
+		g_buffering.lastUnderruns = underruns;
+	} else if (profile->margin > 1.0f) {
+		profile->margin = fmax(1.0f, profile->margin * 0.995f);
+	}
+
+	if (profile->samples < BUFFER_MIN_SAMPLES) return;
+
+	// Rebuffering thresholds follow the stream's own consumption rate
+	float kbps = 0.0f;
+	BASS_ChannelGetAttribute(stream, BASS_ATTRIB_BITRATE, &kbps);
+	float consumption = kbps > 0.0f ? kbps * 125.0f : profile->throughput;
+	DWORD startBytes = BufferStartBytes(profile, consumption);
+
+	DWORD previous = g_buffering.startBytes;
+	DWORD change = startBytes > previous ? startBytes - previous
+										 : previous - startBytes;
+	if (change * 10 > g_buffering.startBytes) {
+		Log("Buffering: threshold %lu -> %lu bytes "
+			"(%.1f kB/s in, %.1f kB/s played, jitter %.1f kB/s)\n",
+			   g_buffering.startBytes, startBytes,
+			   profile->throughput / 1000.0f, consumption / 1000.0f,
+			   profile->jitter / 1000.0f);
+		g_buffering.startBytes = startBytes;
+		g_mixer.minBuffered = startBytes;
+	}
+}
+
+int StartPrefetchWorker() {
+	InitializeCriticalSection(&g_prefetch.lock);
+	g_prefetch.wake = CreateEvent(NULL, FALSE, FALSE, NULL);
+	if (!g_prefetch.wake) return 0;
+
+	g_prefetch.thread = CreateThread(NULL, 0, PrefetchWorkerProc, NULL, 0,
+									 NULL);
+	if (!g_prefetch.thread) {
+		Log("Failed to create prefetch thread\n");
+		return 0;
+	}
+	return 1;
+}
+
+void StopPrefetchWorker() {
+	if (!g_prefetch.thread) return;
+
+	InterlockedExchange(&g_prefetch.quit, 1);
+	SetEvent(g_prefetch.wake);
+	if (WaitForNetWorker(g_prefetch.thread, "Prefetch")) {
+		for (int i = 0; i < PREFETCH_MAX_STREAMS; i++) {
+			if (g_prefetch.pool[i].stream) {
+				BASS_StreamFree(g_prefetch.pool[i].stream);
+			}
+			g_prefetch.pool[i].station = NULL;
+			g_prefetch.pool[i].stream = 0;
+		}
+	}
+	CloseHandle(g_prefetch.thread);
+	g_prefetch.thread = NULL;
+	Log("Prefetch: %lu warm tunes, %lu cold\n", g_prefetch.hits,
+		g_prefetch.misses);
+}
+
+void PrefetchUpdate(float frequency) {
+	if (!g_radio.power) return;
+
+	if (frequency > g_prefetch.lastFrequency) g_prefetch.direction = 1;
+	else if (frequency < g_prefetch.lastFrequency) g_prefetch.direction = -1;
+	g_prefetch.lastFrequency = frequency;
+
+	// The nearest station ahead of the drag, then the nearest of the rest;
+	// the one playing needs no standby
+	RadioStation* wanted[PREFETCH_MAX_STREAMS];
+	int count = 0;
+	if (g_prefetch.direction) {
+		int i = StationIndexLowerBound(&g_stationIndex, frequency);
+		if (g_prefetch.direction < 0) i--;
+		while (i >= 0 && i < g_stationCount &&
+			   fabs(g_stationKeys[i] - frequency) < PREFETCH_RANGE) {
+			if (&g_stations[i] != g_audio.currentStation &&
+				!IsStationOffAir(&g_stations[i])) {
+				wanted[count++] = &g_stations[i];
+				break;
+			}
+			i += g_prefetch.direction;
+		}
+	}
+
+	// One more than the pool so the station playing can be skipped
+	int nearby[PREFETCH_MAX_STREAMS + 2];
+	int found = StationIndexNearby(&g_stationIndex, frequency, PREFETCH_RANGE,
+								   nearby, PREFETCH_MAX_STREAMS + 2);
+	for (int n = 0; n < found && count < PREFETCH_MAX_STREAMS; n++) {
+		RadioStation* station = &g_stations[nearby[n]];
+		if (station == g_audio.currentStation) continue;
+		if (IsStationOffAir(station)) continue;
+		if (count > 0 && wanted[0] == station) continue;
+		wanted[count++] = station;
+	}
+
+	PrefetchSetWanted(wanted, count);
+}
+
+void PrefetchSetWanted(RadioStation** wanted, int count) {
+	int changed = 0;
+
+	EnterCriticalSection(&g_prefetch.lock);
+	for (int i = 0; i < PREFETCH_MAX_STREAMS; i++) {
+		RadioStation* station = i < count ? wanted[i] : NULL;
+		if (g_prefetch.wanted[i] != station) {
+			g_prefetch.wanted[i] = station;
+			changed = 1;
+		}
+	}
+	LeaveCriticalSection(&g_prefetch.lock);
+
+	if (changed) SetEvent(g_prefetch.wake);
+}
+
+HSTREAM PrefetchTake(RadioStation* station) {
+	HSTREAM stream = 0;
+
+	EnterCriticalSection(&g_prefetch.lock);
+	for (int i = 0; i < PREFETCH_MAX_STREAMS; i++) {
+		if (g_prefetch.pool[i].station == station) {
+			stream = g_prefetch.pool[i].stream;
+			g_prefetch.pool[i].station = NULL;
+			g_prefetch.pool[i].stream = 0;
+			break;
+		}
+	}
+	LeaveCriticalSection(&g_prefetch.lock);
+
+	if (stream) g_prefetch.hits++;
+	else g_prefetch.misses++;
+
+	// The worker refills the freed slot for the next wanted station
+	SetEvent(g_prefetch.wake);
+	return stream;
+}
+
+int PrefetchIsWanted(PrefetchPool* pool, RadioStation* station) {
+	for (int i = 0; i < PREFETCH_MAX_STREAMS; i++) {
+		if (pool->wanted[i] == station) return 1;
+	}
+	return 0;
+}
+
+int PrefetchCanTry(RadioStation* station, DWORD now) {
+	PrefetchRetry* retry = &g_prefetchRetry[station - g_stations];
+	return retry->failures == 0 || (LONG)(now - retry->retryAt) >= 0;
+}
+
+void PrefetchFailed(RadioStation* station, DWORD now) {
+	PrefetchRetry* retry = &g_prefetchRetry[station - g_stations];
+	DWORD delay = PREFETCH_RETRY_MAX_MS;
+	if (retry->failures < 16) {
+		delay = PREFETCH_RETRY_BASE_MS << retry->failures;
+		if (delay > PREFETCH_RETRY_MAX_MS) delay = PREFETCH_RETRY_MAX_MS;
+	}
+	retry->failures++;
+	retry->retryAt = now + delay;
+	Log("Prefetch failed: %s (BASS Error: %d), next try in %lu s\n",
+		station->name, BASS_ErrorGetCode(), delay / 1000);
+}
+
+DWORD WINAPI PrefetchWorkerProc(LPVOID param) {
+	while (!g_prefetch.quit) {
+		WaitForSingleObject(g_prefetch.wake, PREFETCH_POLL_MS);
+		if (g_prefetch.quit) break;
+
+		HSTREAM unwanted[PREFETCH_MAX_STREAMS];
+		int unwantedCount = 0;
+		RadioStation* open = NULL;
+		QWORD buffered = 0;
+		DWORD now = GetTickCount();
+
+		// Drop what the dial has moved away from and pick one station to
+		// open; BASS calls happen outside the lock
+		EnterCriticalSection(&g_prefetch.lock);
+		for (int i = 0; i < PREFETCH_MAX_STREAMS; i++) {
+			WarmStream* warm = &g_prefetch.pool[i];
+			if (warm->station &&
+				!PrefetchIsWanted(&g_prefetch, warm->station)) {
+				unwanted[unwantedCount++] = warm->stream;
+				warm->station = NULL;
+				warm->stream = 0;
+			}
+		}
+		for (int w = 0; w < PREFETCH_MAX_STREAMS && !open; w++) {
+			RadioStation* station = g_prefetch.wanted[w];
+			int present = 0;
+			for (int i = 0; i < PREFETCH_MAX_STREAMS; i++) {
+				if (g_prefetch.pool[i].station == station) present = 1;
+			}
+			if (station && !present && PrefetchCanTry(station, now)) {
+				open = station;
+			}
+		}
+		LeaveCriticalSection(&g_prefetch.lock);
+
+		for (int i = 0; i < unwantedCount; i++) {
+			BASS_StreamFree(unwanted[i]);
+		}
+
+		// Memory cap: stop opening once the pool holds enough data
+		EnterCriticalSection(&g_prefetch.lock);
+		for (int i = 0; i < PREFETCH_MAX_STREAMS; i++) {
+			HSTREAM warm = g_prefetch.pool[i].stream;
+			if (warm) {
+				QWORD bytes = BASS_StreamGetFilePosition(warm,
+														 BASS_FILEPOS_BUFFER);
+				if (bytes != (QWORD)-1) buffered += bytes;
+			}
+		}
+		LeaveCriticalSection(&g_prefetch.lock);
+
+		if (!open || buffered >= PREFETCH_MAX_BYTES) continue;
+
+		HSTREAM stream = OpenStationStream(open,
+			BASS_STREAM_BLOCK | BASS_STREAM_DECODE | BASS_SAMPLE_FLOAT,
+			NULL, 0);
+		if (!stream) {
+			PrefetchFailed(open, GetTickCount());
+			continue;
+		}
+		g_prefetchRetry[open - g_stations].failures = 0;
+
+		// Keep it only if it is still wanted and a slot is free
+		int kept = 0;
+		EnterCriticalSection(&g_prefetch.lock);
+		if (PrefetchIsWanted(&g_prefetch, open)) {
+			for (int i = 0; i < PREFETCH_MAX_STREAMS; i++) {
+				if (!g_prefetch.pool[i].station) {
+					g_prefetch.pool[i].station = open;
+					g_prefetch.pool[i].stream = stream;
+					kept = 1;
+					break;
+				}
+			}
+		}
+		LeaveCriticalSection(&g_prefetch.lock);
+
+		if (kept) {
+			Log("Prefetch: %s warm\n", open->name);
+			SetEvent(g_prefetch.wake);  // look for the next one
+		} else {
+			BASS_StreamFree(stream);
+		}
+	}
+	return 0;
+}
+
+int StartConnectWorker(HWND notify) {
+	InitializeCriticalSection(&g_connect.lock);
+	g_connect.notify = notify;
+	g_connect.wake = CreateEvent(NULL, FALSE, FALSE, NULL);
+	if (!g_connect.wake) return 0;
+
+	g_connect.thread = CreateThread(NULL, 0, ConnectWorkerProc, NULL, 0, NULL);
+	if (!g_connect.thread) {
+		Log("Failed to create connect thread\n");
+		return 0;
+	}
+	return 1;
+}
+
+void StopConnectWorker() {
+	if (!g_connect.thread) return;
+
+	ConnectCancel();
+	InterlockedExchange(&g_connect.quit, 1);
+	SetEvent(g_connect.wake);
+
+	WaitForNetWorker(g_connect.thread, "Connect");
+	CloseHandle(g_connect.thread);
+	g_connect.thread = NULL;
+}
+
+int WaitForNetWorker(HANDLE thread, const char* name) {
+	// An open already inside BASS can't be interrupted, but the net
+	// timeout bounds both its connect and its wait for the first data.
+	// BASS_Free must not run under it, so wait that long before giving up
+	DWORD wait = 2 * BASS_GetConfig(BASS_CONFIG_NET_TIMEOUT) +
+				 WORKER_EXIT_SLACK_MS;
+	if (WaitForSingleObject(thread, wait) == WAIT_OBJECT_0) return 1;
+
+	Log("%s thread still busy after %lu ms\n", name, wait);
+	return 0;
+}
+
+void ConnectRequest(RadioStation* station) {
+	EnterCriticalSection(&g_connect.lock);
+	g_connect.pending = station;
+	g_connect.generation++;
+	LeaveCriticalSection(&g_connect.lock);
+
+	SetEvent(g_connect.wake);
+}
+
+void ConnectCancel() {
+	EnterCriticalSection(&g_connect.lock);
+	g_connect.pending = NULL;
+	g_connect.generation++;
+	LeaveCriticalSection(&g_connect.lock);
+}
+
+LONG ConnectGeneration() {
+	EnterCriticalSection(&g_connect.lock);
+	LONG generation = g_connect.generation;
+	LeaveCriticalSection(&g_connect.lock);
+	return generation;
+}
+
+DWORD WINAPI ConnectWorkerProc(LPVOID param) {
+	while (WaitForSingleObject(g_connect.wake, INFINITE) == WAIT_OBJECT_0 &&
+		   !g_connect.quit) {
+		// Requests made while the last open was running collapse into one
+		EnterCriticalSection(&g_connect.lock);
+		RadioStation* station = g_connect.pending;
+		LONG generation = g_connect.generation;
+		g_connect.pending = NULL;
+		LeaveCriticalSection(&g_connect.lock);
+
+		if (!station) continue;
+
+		// Create a decoding stream from the URL; the mixer pulls from it
+		Log("Creating BASS stream...\n");
+		HSTREAM stream = OpenStationStream(station,
+			BASS_STREAM_BLOCK | BASS_STREAM_STATUS | BASS_STREAM_DECODE |
+			BASS_SAMPLE_FLOAT, NULL, 0);
+		if (!stream) {
+			PrintStreamError(station, BASS_ErrorGetCode());
+		}
+
+		if (generation != ConnectGeneration()) {
+			if (stream) {
+				Log("Dropped superseded stream: %s\n", station->name);
+				BASS_StreamFree(stream);
+			}
+			continue;
+		}
+
+		// The UI thread checks the generation again when this arrives
+		if (!PostMessage(g_connect.notify, WM_STATION_READY, (WPARAM)generation,
+						 (LPARAM)stream) && stream) {
+			BASS_StreamFree(stream);
+		}
+	}
+	return 0;
+}
+
+// Mixer callback: station audio and static mixed in one pass
+DWORD CALLBACK MixerStreamProc(HSTREAM handle, void* buffer, DWORD length,
+							   void* user) {
+	float* out = (float*)buffer;
+	DWORD frames = length / (MIXER_CHANNELS * sizeof(float));
+	float station[ATMOSPHERE_BLOCK_SIZE * MIXER_CHANNELS];
+	float noise[ATMOSPHERE_BLOCK_SIZE];
+	float stationGain[ATMOSPHERE_BLOCK_SIZE];
+	float staticGain[ATMOSPHERE_BLOCK_SIZE];
+	DWORD done = 0;
+
+	// Latest posted targets; the gains glide towards them per sample
+	float stationTarget = g_mixer.stationTarget;
+	float staticTarget = g_mixer.staticEnabled ? g_mixer.staticTarget : 0.0f;
+
+	// The tuned station only ever points into g_stations
+	RadioStation* tuned = g_audio.currentStation;
+	float detune = tuned ? fabs(g_radio.frequency - tuned->frequency) : 0.0f;
+
+	while (done < frames) {
+		DWORD chunk = frames - done;
+		if (chunk > ATMOSPHERE_BLOCK_SIZE) chunk = ATMOSPHERE_BLOCK_SIZE;
+
+		MixerReadStation(&g_mixer, station, chunk);
+		TimeshiftCapture(&g_timeshift, station, chunk);
+		TimeshiftReplay(&g_timeshift, station, chunk);
+		IfFilterProcess(&g_ifFilter, station, chunk, detune);
+
+		// The dial is written by the UI thread; a float read is atomic on x86
+		AtmosphereRender(&g_atmosphere, noise, chunk, g_radio.frequency);
+
+		SmoothedParamRender(&g_mixer.stationGain, stationTarget, stationGain,
+							chunk);
+		SmoothedParamRender(&g_mixer.staticGain, staticTarget, staticGain,
+							chunk);
+
+		float* dest = out + done * MIXER_CHANNELS;
+		for (DWORD i = 0; i < chunk; i++) {
+			float hiss = noise[i] * staticGain[i];
+			dest[i * 2] = station[i * 2] * stationGain[i] + hiss;
+			dest[i * 2 + 1] = station[i * 2 + 1] * stationGain[i] + hiss;
+		}
+
+		// Paused: capture carries on, the set goes quiet
+		if (g_timeshift.paused) {
+			memset(dest, 0, chunk * MIXER_CHANNELS * sizeof(float));
+		}
+		done += chunk;
+	}
+
+	MeterBlock(out, frames);
+
+	return length;
+}
+
+int MixerPull(MixerState* mixer) {
+	DWORD size = MIXER_PULL_FRAMES * mixer->stationChans * sizeof(float);
+	DWORD bytes = BASS_ChannelGetData(mixer->station, mixer->pull,
+		size | BASS_DATA_FLOAT);
+	if (bytes == (DWORD)-1 || bytes == 0) {
+		return 0;
+	}
+	mixer->pullFrames = bytes / (mixer->stationChans * sizeof(float));
+	mixer->pullIndex = 0;
+
+	if (mixer->awaitingAudio) {
+		mixer->awaitingAudio = 0;
+		QueryPerformanceCounter(&mixer->firstAudioAt);
+		InterlockedExchange(&mixer->firstAudio, 1);
+	}
+	return 1;
+}
+
+int MixerNextStationFrame(MixerState* mixer) {
+	if (mixer->pullIndex >= mixer->pullFrames && !MixerPull(mixer)) {
+		return 0;
+	}
+
+	// Mono is copied to both sides; extra channels are dropped
+	float* frame = mixer->pull + mixer->pullIndex * mixer->stationChans;
+	mixer->previous[0] = mixer->current[0];
+	mixer->previous[1] = mixer->current[1];
+	mixer->current[0] = frame[0];
+	mixer->current[1] = mixer->stationChans > 1 ? frame[1] : frame[0];
+	mixer->pullIndex++;
+	return 1;
+}
+
+void MixerReadStation(MixerState* mixer, float* out, DWORD frames) {
+	DWORD i = 0;
+
+	if (mixer->station) {
+		// Don't let a decoding channel block the mixing thread waiting for
+		// the network; play silence until enough has been downloaded. Once
+		// playing only an almost empty buffer stops it, and it restarts
+		// at the full threshold
+		QWORD buffered = BASS_StreamGetFilePosition(mixer->station,
+													BASS_FILEPOS_BUFFER);
+		DWORD threshold = MIXER_RUN_FLOOR;
+		if (mixer->starved || mixer->awaitingAudio) {
+			threshold = mixer->minBuffered;
+		}
+		int starved = buffered != (QWORD)-1 && buffered < threshold &&
+					  mixer->pullIndex >= mixer->pullFrames;
+
+		// Station already at the output rate: copy the decoded frames
+		// straight through without interpolating
+		while (mixer->step == 1.0 && i < frames && !starved) {
+			if (mixer->pullIndex >= mixer->pullFrames && !MixerPull(mixer)) {
+				starved = 1;
+				break;
+			}
+
+			DWORD count = mixer->pullFrames - mixer->pullIndex;
+			if (count > frames - i) count = frames - i;
+
+			DWORD chans = mixer->stationChans;
+			float* src = mixer->pull + mixer->pullIndex * chans;
+			if (chans == MIXER_CHANNELS) {
+				memcpy(out + i * 2, src,
+					   count * MIXER_CHANNELS * sizeof(float));
+			} else {
+				for (DWORD k = 0; k < count; k++) {
+					out[(i + k) * 2] = src[k * chans];
+					out[(i + k) * 2 + 1] = src[k * chans + (chans > 1 ? 1 : 0)];
+				}
+			}
+			mixer->pullIndex += count;
+			i += count;
+		}
+
+		for (; i < frames && !starved; i++) {
+			while (mixer->phase >= 1.0) {
+				if (!MixerNextStationFrame(mixer)) {
+					starved = 1;
+					break;
+				}
+				mixer->phase -= 1.0;
+			}
+			if (starved) break;
+
+			float t = (float)mixer->phase;
+			float* previous = mixer->previous;
+			float* current = mixer->current;
+			out[i * 2] = previous[0] + (current[0] - previous[0]) * t;
+			out[i * 2 + 1] = previous[1] + (current[1] - previous[1]) * t;
+			mixer->phase += mixer->step;
+		}
+
+		if (starved && !mixer->starved) {
+			mixer->starvedSince = GetTickCount();
+			mixer->stallCounted = 0;
+			if (!mixer->awaitingAudio) {
+				InterlockedIncrement(&mixer->underruns);
+				InterlockedIncrement(&mixer->stationUnderruns);
+			}
+		} else if (starved && !mixer->awaitingAudio && !mixer->stallCounted &&
+				   GetTickCount() - mixer->starvedSince >= MIXER_STALL_MS) {
+			mixer->stallCounted = 1;
+			InterlockedIncrement(&mixer->stationStalls);
+		}
+		mixer->starved = starved;
+	}
+
+	if (i < frames) {
+		memset(out + i * 2, 0, (frames - i) * MIXER_CHANNELS * sizeof(float));
+	}
+}
+
+void MixerAttach(MixerState* mixer, HSTREAM station, DWORD sampleRate) {
+	BASS_CHANNELINFO info;
+	DWORD chans = 1;
+	double step = 1.0;
+
+	if (station && BASS_ChannelGetInfo(station, &info)) {
+		chans = info.chans;
+		if (chans > MIXER_MAX_SOURCE_CHANNELS) {
+			chans = MIXER_MAX_SOURCE_CHANNELS;
+		}
+		step = (double)info.freq / sampleRate;
+	}
+
+	mixer->station = station;
+	mixer->stationChans = chans;
+	mixer->step = step;
+	mixer->phase = 1.0;  // fetch a fresh frame first
+	mixer->pullFrames = 0;
+	mixer->pullIndex = 0;
+	memset(mixer->previous, 0, sizeof(mixer->previous));
+	memset(mixer->current, 0, sizeof(mixer->current));
+	mixer->awaitingAudio = station != 0;
+	InterlockedExchange(&mixer->firstAudio, 0);
+	mixer->minBuffered = MIXER_MIN_BUFFERED;
+	mixer->starved = 0;
+	InterlockedExchange(&mixer->stationUnderruns, 0);
+	InterlockedExchange(&mixer->stationStalls, 0);
+}
+
+void MixerSetStation(HSTREAM station) {
+	// Keep the mixing thread out while the station changes
+	if (g_audio.outputStream) BASS_ChannelLock(g_audio.outputStream, TRUE);
+
+	MixerAttach(&g_mixer, station, g_sampleRate);
+	SmoothedParamJump(&g_mixer.stationGain, 0.0f);
+	IfFilterReset(&g_ifFilter, IF_SECTIONS, g_sampleRate);
+
+	// A new station always plays live
+	g_timeshift.paused = 0;
+	g_timeshift.shifted = 0;
+
+	if (g_audio.outputStream) BASS_ChannelLock(g_audio.outputStream, FALSE);
+}
+
+int StartMixer() {
+	if (g_audio.outputStream) return 1;
+
+	// The last power cycle's ballistics would show in the first blocks
+	MeterReset();
+
+	g_audio.outputStream = BASS_StreamCreate(g_sampleRate, MIXER_CHANNELS,
+		BASS_SAMPLE_FLOAT, MixerStreamProc, NULL);
+	if (!g_audio.outputStream) {
+		Log("Failed to create mixer stream (BASS Error: %d)\n",
+			BASS_ErrorGetCode());
+		return 0;
+	}
+
+	// Pick up a station tuned while the power was off; fade in from silence
+	MixerSetStation(g_audio.currentStream);
+	SmoothedParamJump(&g_mixer.staticGain, 0.0f);
+
+	LONGLONG traceStart = TraceBegin(&g_trace);
+	BASS_ChannelPlay(g_audio.outputStream, FALSE);
+	TraceEnd(&g_trace, "BASS_ChannelPlay", NULL, traceStart);
+	Log("Mixer started\n");
+	return 1;
+}
+
+void StopMixer() {
+	if (g_audio.outputStream) {
+		BASS_StreamFree(g_audio.outputStream);
+		g_audio.outputStream = 0;
+
+		// The mixer thread is gone; clear what it last published
+		for (int c = 0; c < MIXER_CHANNELS; c++) {
+			g_levels.peak[c] = 0.0f;
+			g_levels.rms[c] = 0.0f;
+		}
+		UpdateVULevels();
+		Log("Mixer stopped\n");
+	}
+}
+
+void SmoothedParamInit(SmoothedParam* param, int mode, float seconds,
+					   float sampleRate, float value) {
+	param->mode = mode;
+	param->rampSamples = (DWORD)(seconds * sampleRate);
+	if (param->rampSamples < 1) param->rampSamples = 1;
+	param->coef = 1.0f - (float)exp(-1.0 / param->rampSamples);
+	SmoothedParamJump(param, value);
+}
+
+void SmoothedParamJump(SmoothedParam* param, float value) {
+	param->value = value;
+	param->target = value;
+	param->remaining = 0;
+	param->step = 0.0f;
+}
+
+void SmoothedParamRender(SmoothedParam* param, float target, float* out,
+						 DWORD count) {
+	DWORD i = 0;
+
+	if (param->mode == SMOOTH_LINEAR) {
+		// A new target restarts a full-length ramp from wherever we are
+		if (target != param->target) {
+			param->target = target;
+			param->remaining = param->rampSamples;
+			param->step = (target - param->value) / param->rampSamples;
+		}
+
+		for (; i < count && param->remaining > 0; i++) {
+			param->value += param->step;
+			if (--param->remaining == 0) {
+				param->value = param->target;  // land exactly despite rounding
+			}
+			out[i] = param->value;
+		}
+	} else {
+		param->target = target;
+		for (; i < count && param->value != target; i++) {
+			param->value += (target - param->value) * param->coef;
+			if (fabs(target - param->value) < 1e-5f) {
+				param->value = target;
+			}
+			out[i] = param->value;
+		}
+	}
+
+	// Settled: hold the value for the rest of the block
+	for (; i < count; i++) {
+		out[i] = param->value;
+	}
+}
+
+void IfFilterReset(IfFilter* filter, int sections, float sampleRate) {
+	if (sections > IF_MAX_SECTIONS) sections = IF_MAX_SECTIONS;
+
+	filter->run = g_ifFilterRun;
+	filter->sections = sections;
+	filter->sampleRate = sampleRate;
+	filter->position = 0;
+	filter->primed = 0;  // jump straight to the first block's response
+	memset(filter->z1, 0, sizeof(filter->z1));
+	memset(filter->z2, 0, sizeof(filter->z2));
+}
+
+void IfFilterProcess(IfFilter* filter, float* samples, DWORD frames,
+					 float detune) {
+	DWORD done = 0;
+
+	// New coefficients only at block boundaries on the filter's own clock,
+	// so the output does not depend on how the mixer splits its buffers
+	while (done < frames) {
+		if (filter->position % IF_BLOCK_SIZE == 0) {
+			IfFilterBeginBlock(filter, detune);
+		}
+
+		DWORD chunk = IF_BLOCK_SIZE - (filter->position % IF_BLOCK_SIZE);
+		if (chunk > frames - done) chunk = frames - done;
+
+		filter->run(filter, samples + done * MIXER_CHANNELS, chunk);
+		filter->position += chunk;
+		done += chunk;
+	}
+}
+
+void IfFilterBeginBlock(IfFilter* filter, float detune) {
+	// Off-tune the passband slides up and narrows: the low end thins out
+	// as the carrier leaves the skirt, the top end muffles
+	float lowPass = IF_LOWPASS_HZ / (1.0f + detune * IF_LOWPASS_SQUEEZE);
+	float highPass = IF_HIGHPASS_HZ + detune * IF_HIGHPASS_SHIFT;
+	if (lowPass < IF_MIN_LOWPASS_HZ) lowPass = IF_MIN_LOWPASS_HZ;
+	if (highPass > lowPass * 0.5f) highPass = lowPass * 0.5f;
+
+	for (int s = 0; s < filter->sections; s++) {
+		// Flush state decaying towards denormals on silent input
+		for (int ch = 0; ch < MIXER_CHANNELS; ch++) {
+			if (fabs(filter->z1[s][ch]) < 1e-15f) filter->z1[s][ch] = 0.0f;
+			if (fabs(filter->z2[s][ch]) < 1e-15f) filter->z2[s][ch] = 0.0f;
+		}
+
+		BiquadCoefs target;
+		IfFilterDesign(&target, s == 1, s == 1 ? highPass : lowPass,
+					   filter->sampleRate);
+
+		if (!filter->primed) {
+			filter->coef[s] = target;
+			memset(&filter->step[s], 0, sizeof(BiquadCoefs));
+			continue;
+		}
+
+		// Glide linearly across the block to avoid zipper clicks
+		BiquadCoefs* c = &filter->coef[s];
+		BiquadCoefs* d = &filter->step[s];
+		const float scale = 1.0f / IF_BLOCK_SIZE;
+		d->b0 = (target.b0 - c->b0) * scale;
+		d->b1 = (target.b1 - c->b1) * scale;
+		d->b2 = (target.b2 - c->b2) * scale;
+		d->a1 = (target.a1 - c->a1) * scale;
+		d->a2 = (target.a2 - c->a2) * scale;
+	}
+	filter->primed = 1;
+}
+
+void IfFilterDesign(BiquadCoefs* coef, int highPass, float cutoff,
+					float sampleRate) {
+	// Butterworth-Q low/high-pass from the RBJ audio EQ cookbook
+	double w0 = 2.0 * 3.14159265358979 * cutoff / sampleRate;
+	double cosw = cos(w0);
+	double alpha = sin(w0) / (2.0 * 0.7071067811865);
+	double a0 = 1.0 + alpha;
+
+	double b1 = highPass ? -(1.0 + cosw) : 1.0 - cosw;
+	double b0 = highPass ? (1.0 + cosw) * 0.5 : (1.0 - cosw) * 0.5;
+	coef->b0 = (float)(b0 / a0);
+	coef->b1 = (float)(b1 / a0);
+	coef->b2 = (float)(b0 / a0);
+	coef->a1 = (float)(2.0 * cosw / a0);
+	coef->a2 = (float)(-(1.0 - alpha) / a0);
+}
+
+void IfFilterRunScalar(IfFilter* filter, float* samples, DWORD frames) {
+	for (DWORD i = 0; i < frames; i++) {
+		float* frame = samples + i * MIXER_CHANNELS;
+
+		for (int s = 0; s < filter->sections; s++) {
+			BiquadCoefs* c = &filter->coef[s];
+			for (int ch = 0; ch < MIXER_CHANNELS; ch++) {
+				float x = frame[ch];
+				float y = c->b0 * x + filter->z1[s][ch];
+				filter->z1[s][ch] = c->b1 * x + c->a1 * y + filter->z2[s][ch];
+				filter->z2[s][ch] = c->b2 * x + c->a2 * y;
+				frame[ch] = y;
+			}
+
+			BiquadCoefs* d = &filter->step[s];
+			c->b0 += d->b0;
+			c->b1 += d->b1;
+			c->b2 += d->b2;
+			c->a1 += d->a1;
+			c->a2 += d->a2;
+		}
+	}
+}
+
+SSE2_TARGET void IfFilterRunSSE2(IfFilter* filter, float* samples,
+								 DWORD frames) {
+	__m128 b0[IF_MAX_SECTIONS], b1[IF_MAX_SECTIONS], b2[IF_MAX_SECTIONS];
+	__m128 a1[IF_MAX_SECTIONS], a2[IF_MAX_SECTIONS];
+	__m128 db0[IF_MAX_SECTIONS], db1[IF_MAX_SECTIONS], db2[IF_MAX_SECTIONS];
+	__m128 da1[IF_MAX_SECTIONS], da2[IF_MAX_SECTIONS];
+	__m128 z1[IF_MAX_SECTIONS], z2[IF_MAX_SECTIONS];
+	int sections = filter->sections;
+
+	// The recursion runs along time, so both channels of a frame share
+	// one register (lanes 0 and 1) and every section steps them together
+	for (int s = 0; s < sections; s++) {
+		b0[s] = _mm_set1_ps(filter->coef[s].b0);
+		b1[s] = _mm_set1_ps(filter->coef[s].b1);
+		b2[s] = _mm_set1_ps(filter->coef[s].b2);
+		a1[s] = _mm_set1_ps(filter->coef[s].a1);
+		a2[s] = _mm_set1_ps(filter->coef[s].a2);
+		db0[s] = _mm_set1_ps(filter->step[s].b0);
+		db1[s] = _mm_set1_ps(filter->step[s].b1);
+		db2[s] = _mm_set1_ps(filter->step[s].b2);
+		da1[s] = _mm_set1_ps(filter->step[s].a1);
+		da2[s] = _mm_set1_ps(filter->step[s].a2);
+		z1[s] = _mm_loadl_pi(_mm_setzero_ps(), (const __m64*)filter->z1[s]);
+		z2[s] = _mm_loadl_pi(_mm_setzero_ps(), (const __m64*)filter->z2[s]);
+	}
+
+	for (DWORD i = 0; i < frames; i++) {
+		// Two floats through the movlps forms, which read them as floats
+		__m64* frame = (__m64*)(samples + i * MIXER_CHANNELS);
+		__m128 x = _mm_loadl_pi(_mm_setzero_ps(), frame);
+
+		for (int s = 0; s < sections; s++) {
+			__m128 y = _mm_add_ps(_mm_mul_ps(b0[s], x), z1[s]);
+			z1[s] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(b1[s], x),
+										  _mm_mul_ps(a1[s], y)), z2[s]);
+			z2[s] = _mm_add_ps(_mm_mul_ps(b2[s], x), _mm_mul_ps(a2[s], y));
+			x = y;
+
+			b0[s] = _mm_add_ps(b0[s], db0[s]);
+			b1[s] = _mm_add_ps(b1[s], db1[s]);
+			b2[s] = _mm_add_ps(b2[s], db2[s]);
+			a1[s] = _mm_add_ps(a1[s], da1[s]);
+			a2[s] = _mm_add_ps(a2[s], da2[s]);
+		}
+
+		_mm_storel_pi(frame, x);
+	}
+
+	for (int s = 0; s < sections; s++) {
+		filter->coef[s].b0 = _mm_cvtss_f32(b0[s]);
+		filter->coef[s].b1 = _mm_cvtss_f32(b1[s]);
+		filter->coef[s].b2 = _mm_cvtss_f32(b2[s]);
+		filter->coef[s].a1 = _mm_cvtss_f32(a1[s]);
+		filter->coef[s].a2 = _mm_cvtss_f32(a2[s]);
+		_mm_storel_pi((__m64*)filter->z1[s], z1[s]);
+		_mm_storel_pi((__m64*)filter->z2[s], z2[s]);
+	}
+}
+
+IfFilterFunc SelectIfFilter() {
+	if (IsProcessorFeaturePresent(PF_XMMI64_INSTRUCTIONS_AVAILABLE)) {
+		Log("IF filter: SSE2\n");
+		return IfFilterRunSSE2;
+	}
 
-	// Check if BASS is initialized
-	if (!BASS_GetVersion()) {
-		printf("BASS not initialized - cannot stream\n");
-		return 0;
+	Log("IF filter: scalar\n");
+	return IfFilterRunScalar;
+}
+
+void NoiseSeed(NoiseGenerator* gen, DWORD seed) {
+	// Spread the seed across the lanes; xorshift32 must never hold zero
+	for (int i = 0; i < 4; i++) {
+		seed = seed * 1664525 + 1013904223;
+		gen->lane[i] = seed ? seed : 0x9E3779B9;
 	}
+	gen->spareCount = 0;
+}
 
-	// Create BASS stream from URL with more options
-	printf("Creating BASS stream...\n");
-	g_audio.currentStream = BASS_StreamCreateURL(station->streamUrl, 0,
-		BASS_STREAM_BLOCK | BASS_STREAM_STATUS | BASS_STREAM_AUTOFREE, NULL, 0);
+void NoiseFillScalar(NoiseGenerator* gen, float* out, DWORD count, float gain) {
+	float scale = gain * NOISE_SCALE;
+	DWORD i = 0;
 
-	if (g_audio.currentStream) {
-		printf("Successfully connected to stream: %s\n", station->name);
+	// Finish the lane step left over from the previous call first, so the
+	// sequence does not depend on how the caller splits its buffers
+	while (i < count && gen->spareCount > 0) {
+		out[i++] = (float)(int)gen->spare[4 - gen->spareCount] * scale;
+		gen->spareCount--;
+	}
 
-		// Get stream info
-		BASS_CHANNELINFO info;
-		if (BASS_ChannelGetInfo(g_audio.currentStream, &info)) {
-			printf("Stream info: %lu Hz, %lu channels, type=%lu\n",
-				   info.freq, info.chans, info.ctype);
+	while (i < count) {
+		// Step all four lanes, emitting up to four samples
+		for (int lane = 0; lane < 4; lane++) {
+			DWORD x = gen->lane[lane];
+			x ^= x << 13;
+			x ^= x >> 17;
+			x ^= x << 5;
+			gen->lane[lane] = x;
+
+			if (i < count) {
+				out[i++] = (float)(int)x * scale;
+			} else {
+				gen->spare[lane] = x;
+				gen->spareCount++;
+			}
 		}
+	}
+}
 
-		// Set volume based on signal strength and radio volume
-		float volume = g_radio.volume * (g_radio.signalStrength / 100.0f);
-		BASS_ChannelSetAttribute(g_audio.currentStream, BASS_ATTRIB_VOL, volume);
-		printf("Set volume to: %.2f\n", volume);
+SSE2_TARGET void NoiseFillSSE2(NoiseGenerator* gen, float* out, DWORD count,
+							   float gain) {
+	DWORD i = 0;
 
-		// Start playing
-		if (BASS_ChannelPlay(g_audio.currentStream, FALSE)) {
-			printf("Stream playback started\n");
-		} else {
-			DWORD error = BASS_ErrorGetCode();
-			printf("Failed to start playback (BASS Error: %lu)\n", error);
+	if (gen->spareCount > 0) {
+		i = (DWORD)gen->spareCount < count ? (DWORD)gen->spareCount : count;
+		NoiseFillScalar(gen, out, i, gain);
+	}
+
+	__m128i state = _mm_loadu_si128((const __m128i*)gen->lane);
+	__m128 scale = _mm_set1_ps(gain * NOISE_SCALE);
+
+	// Four samples per lane step
+	for (; i + 4 <= count; i += 4) {
+		state = _mm_xor_si128(state, _mm_slli_epi32(state, 13));
+		state = _mm_xor_si128(state, _mm_srli_epi32(state, 17));
+		state = _mm_xor_si128(state, _mm_slli_epi32(state, 5));
+		_mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(state), scale));
+	}
+
+	_mm_storeu_si128((__m128i*)gen->lane, state);
+
+	// Remaining samples continue the same lane sequence
+	if (i < count) {
+		NoiseFillScalar(gen, out + i, count - i, gain);
+	}
+}
+
+float NoiseRandomUnit(NoiseGenerator* gen) {
+	// Single draw from lane 0, for rare events rather than audio
+	DWORD x = gen->lane[0];
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	gen->lane[0] = x;
+	return (float)(x >> 8) * (1.0f / 16777216.0f);
+}
+
+void InitSineTable() {
+	for (int i = 0; i <= SINE_TABLE_SIZE; i++) {
+		g_sineTable[i] = (float)sin(2.0 * 3.14159265358979 * i /
+									SINE_TABLE_SIZE);
+	}
+}
+
+void LfoBankReset(LfoBank* bank) {
+	bank->count = 0;
+	bank->position = 0;
+	bank->blockGain = 1.0f;
+}
+
+void LfoBankAdd(LfoBank* bank, float rateHz, float depth, float sampleRate) {
+	if (bank->count >= MAX_LFOS) return;
+
+	Lfo* lfo = &bank->lfo[bank->count++];
+	lfo->phase = 0;
+	lfo->increment = (DWORD)(rateHz / sampleRate * 4294967296.0);
+	lfo->depth = depth;
+}
+
+float SineLookup(DWORD phase) {
+	// Linear interpolation between table entries
+	const int fracBits = 32 - SINE_TABLE_BITS;
+	DWORD index = phase >> fracBits;
+	float frac = (float)(phase & ((1 << fracBits) - 1)) *
+				 (1.0f / (1 << fracBits));
+	float a = g_sineTable[index];
+	return a + (g_sineTable[index + 1] - a) * frac;
+}
+
+float LfoBankGain(LfoBank* bank) {
+	// Recompute only at block boundaries, so the gain for any sample
+	// depends on its position and not on how BASS split the buffers
+	if (bank->position % LFO_BLOCK_SIZE == 0) {
+		float gain = 1.0f;
+		for (int i = 0; i < bank->count; i++) {
+			gain += SineLookup(bank->lfo[i].phase) * bank->lfo[i].depth;
 		}
+		bank->blockGain = gain;
+	}
+	return bank->blockGain;
+}
 
-		g_audio.currentStation = station;
-		return 1;
-	} else {
-		DWORD error = BASS_ErrorGetCode();
-		printf("Failed to connect to stream: %s (BASS Error: %lu)\n", station->name, error);
-		printf("BASS Error meanings:\n");
-		printf("  1 = BASS_ERROR_MEM (out of memory)\n");
-		printf("  2 = BASS_ERROR_FILEOPEN (file/URL cannot be opened)\n");
-		printf("  3 = BASS_ERROR_DRIVER (no audio driver available)\n");
-		printf("  6 = BASS_ERROR_FORMAT (unsupported format)\n");
-		printf("  7 = BASS_ERROR_POSITION (invalid position)\n");
-		printf("  14 = BASS_ERROR_DEVICE (invalid device)\n");
-		printf("  21 = BASS_ERROR_TIMEOUT (connection timeout)\n");
-		printf("  41 = BASS_ERROR_SSL (SSL/HTTPS not supported)\n");
+void LfoBankAdvance(LfoBank* bank, DWORD samples) {
+	// Unsigned overflow wraps the phase around the cycle
+	for (int i = 0; i < bank->count; i++) {
+		bank->lfo[i].phase += bank->lfo[i].increment * samples;
 	}
+	bank->position += samples;
+}
 
-	return 0;
+void AtmosphereReset(AtmosphereState* state, DWORD seed, float sampleRate) {
+	memset(state, 0, sizeof(AtmosphereState));
+	state->sampleRate = sampleRate;
+	NoiseSeed(&state->white, seed);
+	NoiseSeed(&state->events, seed ^ 0xA5A5A5A5);
+
+	// Roughly a 3.5 kHz receiver passband, split at 600 Hz for fading
+	state->bandCoef = 1.0f - (float)exp(-2.0 * 3.14159265 * 3500.0 /
+										sampleRate);
+	state->splitCoef = 1.0f - (float)exp(-2.0 * 3.14159265 * 600.0 /
+										 sampleRate);
+
+	// Subtle volume oscillations (5-7% variation) at three rates,
+	// given in radians per second: 3% slow, 2% medium and 1.5% fast
+	const float radiansToHz = 1.0f / (2.0f * 3.14159f);
+	LfoBankReset(&state->swell);
+	LfoBankAdd(&state->swell, 0.7f * radiansToHz, 0.03f, sampleRate);
+	LfoBankAdd(&state->swell, 2.3f * radiansToHz, 0.02f, sampleRate);
+	LfoBankAdd(&state->swell, 5.1f * radiansToHz, 0.015f, sampleRate);
+
+	// Deep, slow fades; the two halves drift in and out independently
+	LfoBankReset(&state->fadeLow);
+	LfoBankAdd(&state->fadeLow, 0.071f, 0.35f, sampleRate);
+	LfoBankAdd(&state->fadeLow, 0.19f, 0.2f, sampleRate);
+	LfoBankReset(&state->fadeHigh);
+	LfoBankAdd(&state->fadeHigh, 0.053f, 0.4f, sampleRate);
+	LfoBankAdd(&state->fadeHigh, 0.23f, 0.15f, sampleRate);
+	state->lowGain = 1.0f;
+	state->highGain = 1.0f;
+
+	state->carriers = &g_stationIndex;
+	AtmosphereScheduleCrackle(state);
 }
 
-void StopBassStreaming() {
-	if (g_audio.currentStream) {
-		BASS_StreamFree(g_audio.currentStream);
-		g_audio.currentStream = 0;
-		printf("Stopped streaming\n");
+void AtmosphereScheduleCrackle(AtmosphereState* state) {
+	// Strikes arrive at random (exponential gaps), often in quick clusters
+	float u = NoiseRandomUnit(&state->events);
+	float interval = CRACKLE_MEAN_INTERVAL * -(float)log(1.0f - u);
+	if (NoiseRandomUnit(&state->events) < 0.4f) {
+		interval *= 0.05f;
 	}
+	if (interval < CRACKLE_MIN_INTERVAL) interval = CRACKLE_MIN_INTERVAL;
+	state->crackleCountdown = (DWORD)(interval * state->sampleRate);
+}
 
-	g_audio.currentStation = NULL;
+void AtmosphereBeginBlock(AtmosphereState* state, float dialFrequency) {
+	const float blockScale = 1.0f / ATMOSPHERE_BLOCK_SIZE;
+
+	// Fade gains ramp linearly to this block's LFO values
+	float lowTarget = LfoBankGain(&state->fadeLow);
+	float highTarget = LfoBankGain(&state->fadeHigh);
+	LfoBankAdvance(&state->fadeLow, ATMOSPHERE_BLOCK_SIZE);
+	LfoBankAdvance(&state->fadeHigh, ATMOSPHERE_BLOCK_SIZE);
+	state->lowGainStep = (lowTarget - state->lowGain) * blockScale;
+	state->highGainStep = (highTarget - state->highGain) * blockScale;
+
+	// Find the carriers closest to the dial; each beats against the
+	// receiver to produce a whistle
+	float offsets[MAX_WHISTLES];
+	int nearest[MAX_WHISTLES];
+	int found = StationIndexNearby(state->carriers, dialFrequency,
+								   WHISTLE_MAX_OFFSET, nearest, MAX_WHISTLES);
+	for (int w = 0; w < MAX_WHISTLES; w++) {
+		offsets[w] = w < found
+			? fabs(state->carriers->keys[nearest[w]] - dialFrequency)
+			: WHISTLE_MAX_OFFSET;
+	}
+
+	for (int w = 0; w < MAX_WHISTLES; w++) {
+		Whistle* whistle = &state->whistle[w];
+		float pitch = offsets[w] * WHISTLE_HZ_PER_MHZ;
+
+		// Louder close to the carrier, silent past the max offset and
+		// fading out near zero beat
+		float level = WHISTLE_LEVEL * (1.0f - offsets[w] / WHISTLE_MAX_OFFSET);
+		if (pitch < 150.0f) level *= pitch / 150.0f;
+
+		DWORD targetIncrement = (DWORD)(pitch / state->sampleRate *
+										4294967296.0);
+		if (whistle->level < 0.0001f) {
+			// Start a silent whistle at its target pitch instead of gliding
+			whistle->increment = targetIncrement;
+		}
+		int glide = (int)targetIncrement - (int)whistle->increment;
+		whistle->incrementStep = glide / ATMOSPHERE_BLOCK_SIZE;
+		whistle->levelStep = (level - whistle->level) * blockScale;
+	}
 }
 
-// Static noise generation callback
-DWORD CALLBACK StaticStreamProc(HSTREAM handle, void* buffer, DWORD length, void* user) {
-	short* samples = (short*)buffer;
-	DWORD sampleCount = length / sizeof(short);
+void AtmosphereRender(AtmosphereState* state, float* out, DWORD count,
+					  float dialFrequency) {
+	float white[LFO_BLOCK_SIZE];
+	DWORD done = 0;
 
-	// Get current time for oscillation
-	static DWORD startTime = GetTickCount();
-	DWORD currentTime = GetTickCount();
-	float timeSeconds = (currentTime - startTime) / 1000.0f;
+	while (done < count) {
+		if (state->position % ATMOSPHERE_BLOCK_SIZE == 0) {
+			AtmosphereBeginBlock(state, dialFrequency);
+		}
+
+		// Stay inside one swell LFO block and one atmosphere block
+		DWORD chunk = LFO_BLOCK_SIZE - (state->position % LFO_BLOCK_SIZE);
+		if (chunk > count - done) chunk = count - done;
+
+		float swell = LfoBankGain(&state->swell);
+		g_noiseFill(&state->white, white, chunk, 1.0f);
+
+		float* dest = out + done;
+		for (DWORD i = 0; i < chunk; i++) {
+			float w = white[i];
+
+			// Pink noise (Paul Kellet's economy filter) and brown noise
+			state->pink[0] = 0.99765f * state->pink[0] + w * 0.0990460f;
+			state->pink[1] = 0.96300f * state->pink[1] + w * 0.2965164f;
+			state->pink[2] = 0.57000f * state->pink[2] + w * 1.0526913f;
+			float pink = (state->pink[0] + state->pink[1] + state->pink[2] +
+						  w * 0.1848f) * 0.25f;
+			state->brown = (state->brown + w * 0.02f) * (1.0f / 1.02f);
+			float hiss = w * 0.15f + pink * 0.6f + state->brown * 2.5f;
+
+			// Impulsive crackle rides on the same noise
+			if (state->crackleCountdown == 0) {
+				float strike = NoiseRandomUnit(&state->events);
+				state->crackleLevel = 0.3f + 0.9f * strike * strike * strike;
+				state->crackleDecay = 0.990f +
+					0.008f * NoiseRandomUnit(&state->events);
+				AtmosphereScheduleCrackle(state);
+			} else {
+				state->crackleCountdown--;
+			}
+			hiss += w * state->crackleLevel;
+			state->crackleLevel *= state->crackleDecay;
+
+			// Band-limit, then fade the low and high halves separately
+			state->bandState += (hiss - state->bandState) * state->bandCoef;
+			state->splitState += (state->bandState - state->splitState) *
+								 state->splitCoef;
+			float low = state->splitState;
+			float high = state->bandState - low;
+			float sample = low * state->lowGain + high * state->highGain;
+			state->lowGain += state->lowGainStep;
+			state->highGain += state->highGainStep;
+
+			for (int k = 0; k < MAX_WHISTLES; k++) {
+				Whistle* whistle = &state->whistle[k];
+				sample += SineLookup(whistle->phase) * whistle->level;
+				whistle->phase += whistle->increment;
+				whistle->increment += whistle->incrementStep;
+				whistle->level += whistle->levelStep;
+			}
 
-	// Create subtle volume oscillations (5-7% variation)
-	// Use multiple sine waves at different frequencies for natural variation
-	float oscillation1 = sin(timeSeconds * 0.7f) * 0.03f;      // 3% slow oscillation
-	float oscillation2 = sin(timeSeconds * 2.3f) * 0.02f;      // 2% medium oscillation
-	float oscillation3 = sin(timeSeconds * 5.1f) * 0.015f;     // 1.5% fast oscillation
-	float volumeVariation = 1.0f + oscillation1 + oscillation2 + oscillation3;
+			dest[i] = sample * swell;
+		}
 
-	// Generate white noise with volume variation
-	for (DWORD i = 0; i < sampleCount; i++) {
-		// Generate random value between -32767 and 32767
-		short baseNoise = (short)((rand() % 65535) - 32767);
+		LfoBankAdvance(&state->swell, chunk);
+		state->position += chunk;
+		done += chunk;
+	}
+}
 
-		// Apply volume variation
-		samples[i] = (short)(baseNoise * volumeVariation);
+NoiseFillFunc SelectNoiseFill() {
+	// XP-era CPUs without SSE2 (Athlon XP, Pentium III) get the scalar path
+	if (IsProcessorFeaturePresent(PF_XMMI64_INSTRUCTIONS_AVAILABLE)) {
+		Log("Noise generator: SSE2\n");
+		return NoiseFillSSE2;
 	}
 
-	return length;
+	Log("Noise generator: scalar\n");
+	return NoiseFillScalar;
 }
 
 void StartStaticNoise() {
-	if (!g_audio.staticStream) {
-		// Create a stream for static noise generation
-		g_audio.staticStream = BASS_StreamCreate(SAMPLE_RATE, CHANNELS, 0, StaticStreamProc, NULL);
+	if (!g_mixer.staticEnabled) {
+		if (g_audio.outputStream) BASS_ChannelLock(g_audio.outputStream, TRUE);
 
-		if (g_audio.staticStream) {
-			// Set initial volume based on signal strength
-			UpdateStaticVolume(g_radio.signalStrength);
+		// Restart the atmosphere from a known state so a given number of
+		// samples at a given dial position always renders the same output
+		AtmosphereReset(&g_atmosphere, STATIC_NOISE_SEED, (float)g_sampleRate);
+		g_mixer.staticEnabled = 1;
 
-			// Start playing static
-			BASS_ChannelPlay(g_audio.staticStream, FALSE);
-			printf("Static noise started\n");
-		} else {
-			printf("Failed to create static stream\n");
-		}
+		if (g_audio.outputStream) BASS_ChannelLock(g_audio.outputStream, FALSE);
+
+		// Set initial volume based on signal strength
+		UpdateStaticVolume(g_radio.signalStrength);
+		Log("Static noise started\n");
 	}
 }
 
 void StopStaticNoise() {
-	if (g_audio.staticStream) {
-		BASS_StreamFree(g_audio.staticStream);
-		g_audio.staticStream = 0;
-		printf("Static noise stopped\n");
+	if (g_mixer.staticEnabled) {
+		// The mixer ramps the static out over its next buffer
+		g_mixer.staticEnabled = 0;
+		Log("Static noise stopped\n");
 	}
 }
 
 void UpdateStaticVolume(float signalStrength) {
-	if (g_audio.staticStream) {
-		// Static volume is inverse of signal strength
-		// Strong signal = less static, weak signal = more static
-		float staticLevel = (100.0f - signalStrength) / 100.0f;
-		float volume = g_radio.volume * staticLevel * g_audio.staticVolume;
-
-		// Ensure minimum static when radio is on but no strong signal
-		if (g_radio.power && signalStrength < 50.0f) {
-			volume = fmax(volume, g_radio.volume * 0.1f);
-		}
+	// Static volume is inverse of signal strength
+	// Strong signal = less static, weak signal = more static
+	float staticLevel = (100.0f - signalStrength) / 100.0f;
+	float volume = g_radio.volume * staticLevel * g_audio.staticVolume;
+
+	// While reconnecting the carrier is gone, so the static fills in
+	if (g_supervisor.dropped) {
+		volume = g_radio.volume * 0.6f * g_audio.staticVolume;
+	}
 
-		BASS_ChannelSetAttribute(g_audio.staticStream, BASS_ATTRIB_VOL, volume);
+	// Ensure minimum static when radio is on but no strong signal
+	if (g_radio.power && signalStrength < 50.0f) {
+		volume = fmax(volume, g_radio.volume * 0.1f);
 	}
+
+	// Only posts the target; the mixer glides to it
+	g_mixer.staticTarget = volume;
 }
 
 void UpdateStreamVolume() {
 	if (g_audio.currentStream) {
 		// Stream volume based on signal strength and radio volume
 		float volume = g_radio.volume * (g_radio.signalStrength / 100.0f);
-		BASS_ChannelSetAttribute(g_audio.currentStream, BASS_ATTRIB_VOL, volume);
+		g_mixer.stationTarget = volume;
 		if (g_consoleVisible) {
-			printf("Updated stream volume to: %.2f\n", volume);
+			Log("Updated stream volume to: %.2f\n", volume);
+		}
+	}
+}
+
+int InitBandScope() {
+	if (g_scope.dc) return 1;
+
+	BITMAPINFO bmi = {};
+	bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+	bmi.bmiHeader.biWidth = SCOPE_WIDTH;
+	bmi.bmiHeader.biHeight = -SCOPE_HEIGHT;  // top-down rows
+	bmi.bmiHeader.biPlanes = 1;
+	bmi.bmiHeader.biBitCount = 32;
+	bmi.bmiHeader.biCompression = BI_RGB;
+
+	void* bits = NULL;
+	g_scope.bitmap = CreateDIBSection(NULL, &bmi, DIB_RGB_COLORS, &bits,
+									  NULL, 0);
+	if (!g_scope.bitmap || !bits) {
+		Log("Failed to create band scope bitmap\n");
+		return 0;
+	}
+
+	g_scope.dc = CreateCompatibleDC(NULL);
+	if (!g_scope.dc) {
+		DeleteObject(g_scope.bitmap);
+		g_scope.bitmap = NULL;
+		return 0;
+	}
+	SelectObject(g_scope.dc, g_scope.bitmap);
+	g_scope.pixels = (DWORD*)bits;
+	memset(g_scope.pixels, 0, SCOPE_WIDTH * SCOPE_HEIGHT * sizeof(DWORD));
+
+	// Waterfall palette: black -> dark green -> green -> yellow -> white
+	// (DIB pixels are 0x00RRGGBB)
+	for (int i = 0; i < 256; i++) {
+		int r, g, b;
+		if (i < 96) {
+			r = 0; g = i * 128 / 96; b = i * 32 / 96;
+		} else if (i < 176) {
+			r = 0; g = 128 + (i - 96) * 127 / 80; b = 32 - (i - 96) * 32 / 80;
+		} else if (i < 232) {
+			r = (i - 176) * 255 / 56; g = 255; b = 0;
+		} else {
+			r = 255; g = 255; b = (i - 232) * 255 / 23;
+		}
+		g_scope.palette[i] = (r << 16) | (g << 8) | b;
+	}
+
+	return 1;
+}
+
+void CleanupBandScope() {
+	if (g_scope.dc) {
+		DeleteDC(g_scope.dc);
+		g_scope.dc = NULL;
+	}
+	if (g_scope.bitmap) {
+		DeleteObject(g_scope.bitmap);
+		g_scope.bitmap = NULL;
+	}
+	g_scope.pixels = NULL;
+}
+
+void UpdateBandScope() {
+	if (!InitBandScope()) return;
+
+	// BASS computes the FFT from the output's playback buffer without
+	// consuming it; silence when nothing is playing
+	if (!g_audio.outputStream ||
+		BASS_ChannelGetData(g_audio.outputStream, g_scope.fft,
+							BASS_DATA_FFT512) == (DWORD)-1) {
+		memset(g_scope.fft, 0, sizeof(g_scope.fft));
+	}
+
+	RenderBandScope();
+}
+
+void RenderBandScope() {
+	// Map each column to a bin and its magnitude to 0-255 on a dB scale
+	for (int x = 0; x < SCOPE_WIDTH; x++) {
+		int bin = 1 + x * (SCOPE_MAX_BIN - 1) / SCOPE_WIDTH;
+		float magnitude = g_scope.fft[bin];
+		float level = 0.0f;
+		if (magnitude > 0.0f) {
+			float db = 20.0f * (float)log10(magnitude);
+			level = (db - SCOPE_FLOOR_DB) / -SCOPE_FLOOR_DB;
+			if (level < 0.0f) level = 0.0f;
+			if (level > 1.0f) level = 1.0f;
+		}
+		g_scope.columnLevel[x] = (BYTE)(level * 255.0f);
+	}
+
+	// Make sure GDI is done with the bitmap before touching the bits
+	GdiFlush();
+
+	// Spectrum: bars rising from the bottom of the top section
+	const DWORD background = 0x00101010;
+	const DWORD barColor = g_scope.palette[200];
+	for (int y = 0; y < SCOPE_SPECTRUM_HEIGHT; y++) {
+		DWORD* row = g_scope.pixels + y * SCOPE_WIDTH;
+		int threshold = (SCOPE_SPECTRUM_HEIGHT - y) * 255 /
+						SCOPE_SPECTRUM_HEIGHT;
+		for (int x = 0; x < SCOPE_WIDTH; x++) {
+			int lit = g_scope.columnLevel[x] >= threshold;
+			row[x] = lit ? barColor : background;
 		}
 	}
+
+	// Waterfall: scroll down one row and add the newest at the top
+	DWORD* waterfall = g_scope.pixels + SCOPE_SPECTRUM_HEIGHT * SCOPE_WIDTH;
+	memmove(waterfall + SCOPE_WIDTH, waterfall,
+			(SCOPE_WATERFALL_HEIGHT - 1) * SCOPE_WIDTH * sizeof(DWORD));
+	for (int x = 0; x < SCOPE_WIDTH; x++) {
+		waterfall[x] = g_scope.palette[g_scope.columnLevel[x]];
+	}
 }
 
 void UpdateVULevels() {
-	// Initialize levels to zero
-	g_audio.vuLevelLeft = 0.0f;
-	g_audio.vuLevelRight = 0.0f;
+	float peak[MIXER_CHANNELS];
+	float rms[MIXER_CHANNELS];
+
+	// Levels are measured on the mixer output, i.e. what the speaker gets;
+	// scale RMS by sqrt(2) so a full-scale sine reads 1.0
+	ReadLevels(peak, rms);
+	g_audio.vuLevelLeft = fmin(1.0f, rms[0] * 1.414f);
+	g_audio.vuLevelRight = fmin(1.0f, rms[1] * 1.414f);
+	g_audio.vuPeakLeft = fmin(1.0f, peak[0]);
+	g_audio.vuPeakRight = fmin(1.0f, peak[1]);
+}
+
+void MeterBlock(const float* samples, DWORD frames) {
+	float* peakHold = g_meter.peakHold;
+	float* meanSquare = g_meter.meanSquare;
+
+	if (frames == 0) return;
+
+	float blockPeak[MIXER_CHANNELS] = {0.0f, 0.0f};
+	float blockSum[MIXER_CHANNELS] = {0.0f, 0.0f};
+	for (DWORD i = 0; i < frames; i++) {
+		for (int c = 0; c < MIXER_CHANNELS; c++) {
+			float value = samples[i * MIXER_CHANNELS + c];
+			float magnitude = value < 0.0f ? -value : value;
+			if (magnitude > blockPeak[c]) blockPeak[c] = magnitude;
+			blockSum[c] += value * value;
+		}
+	}
+
+	// Ballistics scale with the block length so the meter behaves the
+	// same whatever buffer size BASS asks for
+	float seconds = (float)frames / g_sampleRate;
+	float rmsKeep = (float)exp(-seconds / METER_RMS_TIME);
+	float peakKeep = (float)pow(0.1, seconds / METER_PEAK_RELEASE);
+
+	for (int c = 0; c < MIXER_CHANNELS; c++) {
+		meanSquare[c] = meanSquare[c] * rmsKeep +
+						(blockSum[c] / frames) * (1.0f - rmsKeep);
+		peakHold[c] *= peakKeep;
+		if (blockPeak[c] > peakHold[c]) peakHold[c] = blockPeak[c];
+	}
+
+	// Publish: odd sequence while writing
+	InterlockedIncrement(&g_levels.sequence);
+	for (int c = 0; c < MIXER_CHANNELS; c++) {
+		g_levels.peak[c] = peakHold[c];
+		g_levels.rms[c] = (float)sqrt(meanSquare[c]);
+	}
+	InterlockedIncrement(&g_levels.sequence);
+}
+
+void MeterReset() {
+	// Only while no mixer thread is running
+	memset(&g_meter, 0, sizeof(g_meter));
+}
+
+void ReadLevels(float* peak, float* rms) {
+	// Never blocks the mixer: retry if an update raced with the copy
+	LONG before, after;
+	do {
+		before = g_levels.sequence;
+		for (int c = 0; c < MIXER_CHANNELS; c++) {
+			peak[c] = g_levels.peak[c];
+			rms[c] = g_levels.rms[c];
+		}
+		after = InterlockedCompareExchange(&g_levels.sequence, 0, 0);
+	} while ((before & 1) || before != after);
+}
+
+void ShowDebugConsole() {
+	if (!g_consoleWindow) {
+		// First time - allocate console
+		AllocConsole();
+		freopen("CONOUT$", "w", stdout);
+		freopen("CONOUT$", "w", stderr);
+		g_consoleWindow = GetConsoleWindow();
+		printf("Shortwave Radio Debug Console\n");
+		printf("=============================\n");
+	} else {
+		// Console exists, just show it
+		ShowWindow(g_consoleWindow, SW_SHOW);
+	}
+	g_consoleVisible = 1;
+}
+
+double GetElapsedSeconds(LARGE_INTEGER start) {
+	LARGE_INTEGER now, frequency;
+	QueryPerformanceCounter(&now);
+	QueryPerformanceFrequency(&frequency);
+	return (double)(now.QuadPart - start.QuadPart) / (double)frequency.QuadPart;
+}
+
+void RunBenchmarks() {
+	printf("\nRunning benchmarks...\n");
+	BenchmarkNoiseGenerator();
+	BenchmarkAtmosphere();
+	BenchmarkBandScope();
+	BenchmarkPropagation();
+	BenchmarkIfFilter();
+	BenchmarkStationPath();
+	BenchmarkPipeline();
+	BenchmarkTuner();
+	BenchmarkIcyParser();
+	BenchmarkTimeshift();
+	BenchmarkStationDirectory();
+	BenchmarkLogging();
+	BenchmarkTrace();
+	BenchmarkFrame();
+	printf("Benchmarks finished\n");
+}
+
+void BenchmarkNoiseGenerator() {
+	static float samples[BUFFER_SIZE];
+	const int iterations = 2000;
+	double totalSamples = (double)BUFFER_SIZE * iterations;
+	NoiseGenerator gen;
+	LARGE_INTEGER start;
+
+	printf("Static noise (%d x %d samples):\n", iterations, BUFFER_SIZE);
+
+	// Original per-sample rand() loop, for comparison
+	QueryPerformanceCounter(&start);
+	for (int n = 0; n < iterations; n++) {
+		for (int i = 0; i < BUFFER_SIZE; i++) {
+			short baseNoise = (short)((rand() % 65535) - 32767);
+			samples[i] = baseNoise * (1.01f / 32768.0f);
+		}
+	}
+	double seconds = GetElapsedSeconds(start);
+	printf("  rand() loop: %.1f Msamples/s\n", totalSamples / seconds / 1e6);
+
+	NoiseSeed(&gen, 1);
+	QueryPerformanceCounter(&start);
+	for (int n = 0; n < iterations; n++) {
+		NoiseFillScalar(&gen, samples, BUFFER_SIZE, 1.01f);
+	}
+	seconds = GetElapsedSeconds(start);
+	printf("  xorshift scalar: %.1f Msamples/s\n",
+		   totalSamples / seconds / 1e6);
+
+	if (IsProcessorFeaturePresent(PF_XMMI64_INSTRUCTIONS_AVAILABLE)) {
+		NoiseSeed(&gen, 1);
+		QueryPerformanceCounter(&start);
+		for (int n = 0; n < iterations; n++) {
+			NoiseFillSSE2(&gen, samples, BUFFER_SIZE, 1.01f);
+		}
+		seconds = GetElapsedSeconds(start);
+		printf("  xorshift SSE2: %.1f Msamples/s\n",
+			   totalSamples / seconds / 1e6);
+	} else {
+		printf("  xorshift SSE2: not supported on this CPU\n");
+	}
+}
+
+void BenchmarkAtmosphere() {
+	static AtmosphereState state;
+	static float block[ATMOSPHERE_BLOCK_SIZE];
+	static const float carrierKeys[2] = {10.90f, 11.20f};
+	static int carrierBuckets[3];
+	const int iterations = 2000;
+	LARGE_INTEGER start;
+
+	// Worst case: dial 0.1 and 0.2 MHz from two carriers so both
+	// whistles are audible, with the crackle forced on every block. The
+	// built-in band plan has no two carriers that close together
+	StationIndex carriers;
+	BuildStationIndex(&carriers, carrierKeys, 2, carrierBuckets, 2);
+	AtmosphereReset(&state, 1, (float)g_sampleRate);
+	state.carriers = &carriers;
+	QueryPerformanceCounter(&start);
+	for (int n = 0; n < iterations; n++) {
+		state.crackleCountdown = 0;
+		AtmosphereRender(&state, block, ATMOSPHERE_BLOCK_SIZE, 11.0f);
+	}
+	double microseconds = GetElapsedSeconds(start) * 1e6 / iterations;
+	double blockMicroseconds = ATMOSPHERE_BLOCK_SIZE * 1e6 / g_sampleRate;
+
+	int nearest[MAX_WHISTLES];
+	int whistles = StationIndexNearby(&carriers, 11.0f, WHISTLE_MAX_OFFSET,
+									  nearest, MAX_WHISTLES);
+	printf("Atmosphere (%d-sample blocks, %d whistles):\n",
+		   ATMOSPHERE_BLOCK_SIZE, whistles);
+	printf("  %.1f us per block (%.1f%% of real time), budget %.0f us: %s\n",
+		   microseconds, microseconds * 100.0 / blockMicroseconds,
+		   ATMOSPHERE_BUDGET_US,
+		   microseconds <= ATMOSPHERE_BUDGET_US ? "OK" : "OVER");
+}
+
+void BenchmarkBandScope() {
+	const int iterations = 1000;
+	LARGE_INTEGER start;
+
+	if (!InitBandScope()) return;
+
+	// Blit target standing in for the paint buffer
+	HDC screenDC = CreateCompatibleDC(NULL);
+	HBITMAP target = CreateCompatibleBitmap(g_scope.dc, SCOPE_WIDTH,
+											SCOPE_HEIGHT);
+	HBITMAP oldTarget = (HBITMAP)SelectObject(screenDC, target);
+
+	// Synthetic spectrum that changes every frame; the live panel is
+	// restored afterwards
+	static DWORD savedPixels[SCOPE_WIDTH * SCOPE_HEIGHT];
+	float savedFft[SCOPE_FFT_BINS];
+	memcpy(savedPixels, g_scope.pixels, sizeof(savedPixels));
+	memcpy(savedFft, g_scope.fft, sizeof(savedFft));
+
+	QueryPerformanceCounter(&start);
+	for (int n = 0; n < iterations; n++) {
+		for (int i = 0; i < SCOPE_FFT_BINS; i++) {
+			g_scope.fft[i] = 0.5f / (1 + ((i + n) & 63));
+		}
+		RenderBandScope();
+		BitBlt(screenDC, 0, 0, SCOPE_WIDTH, SCOPE_HEIGHT, g_scope.dc, 0, 0,
+			   SRCCOPY);
+	}
+	GdiFlush();
+	double microseconds = GetElapsedSeconds(start) * 1e6 / iterations;
+
+	printf("Band scope (%dx%d):\n", SCOPE_WIDTH, SCOPE_HEIGHT);
+	printf("  %.1f us per frame (render + blit), budget %.0f us: %s\n",
+		   microseconds, SCOPE_BUDGET_US,
+		   microseconds <= SCOPE_BUDGET_US ? "OK" : "OVER");
+
+	memcpy(g_scope.pixels, savedPixels, sizeof(savedPixels));
+	memcpy(g_scope.fft, savedFft, sizeof(savedFft));
+	SelectObject(screenDC, oldTarget);
+	DeleteObject(target);
+	DeleteDC(screenDC);
+}
+
+void BenchmarkPropagation() {
+	const int points = 100000;
+	float maxError = 0.0f;
+	float worstDetune = 0.0f;
+	volatile float sink = 0.0f;
+	LARGE_INTEGER start;
+
+	// Accuracy of the interpolated table against the analytic skirt
+	// across the whole capture range
+	for (int i = 0; i < points; i++) {
+		float detune = i * SKIRT_TABLE_RANGE / points;
+		float error = fabs(SkirtResponse(detune) -
+						   SkirtResponseAnalytic(detune));
+		if (error > maxError) {
+			maxError = error;
+			worstDetune = detune;
+		}
+	}
+
+	QueryPerformanceCounter(&start);
+	for (int i = 0; i < points; i++) {
+		sink += SkirtResponseAnalytic(i * SKIRT_TABLE_RANGE / points);
+	}
+	double analyticNs = GetElapsedSeconds(start) * 1e9 / points;
+
+	QueryPerformanceCounter(&start);
+	for (int i = 0; i < points; i++) {
+		sink += SkirtResponse(i * SKIRT_TABLE_RANGE / points);
+	}
+	double tableNs = GetElapsedSeconds(start) * 1e9 / points;
+
+	QueryPerformanceCounter(&start);
+	for (int i = 0; i < points; i++) {
+		RadioStation* station = &g_stations[i % g_stationCount];
+		sink += GetStationSignalStrength(station, 15.0f);
+	}
+	double fullNs = GetElapsedSeconds(start) * 1e9 / points;
+
+	printf("Propagation model:\n");
+	printf("  table vs analytic: max error %.6f at %.4f MHz detune, "
+		   "tolerance %.6f: %s\n", maxError, worstDetune,
+		   SKIRT_TABLE_TOLERANCE,
+		   maxError <= SKIRT_TABLE_TOLERANCE ? "OK" : "FAIL");
+	printf("  analytic %.1f ns, table %.1f ns, full signal strength %.1f ns\n",
+		   analyticNs, tableNs, fullNs);
+}
+
+void BenchmarkIfFilter() {
+	static IfFilter filter;
+	static float samples[BUFFER_SIZE * MIXER_CHANNELS];
+	const int iterations = 200;
+	double totalFrames = (double)BUFFER_SIZE * iterations;
+	IfFilterFunc runs[2] = {IfFilterRunScalar, IfFilterRunSSE2};
+	const char* names[2] = {"scalar", "SSE2"};
+	int paths = 1;
+	if (IsProcessorFeaturePresent(PF_XMMI64_INSTRUCTIONS_AVAILABLE)) paths = 2;
+	NoiseGenerator gen;
+	LARGE_INTEGER start;
+
+	NoiseSeed(&gen, 1);
+	NoiseFillScalar(&gen, samples, BUFFER_SIZE * MIXER_CHANNELS, 0.5f);
+
+	// Detune sweeps every buffer so the coefficients are always gliding
+	printf("IF filter (stereo, %d x %d frames):\n", iterations, BUFFER_SIZE);
+	for (int p = 0; p < paths; p++) {
+		for (int sections = 1; sections <= IF_MAX_SECTIONS; sections++) {
+			IfFilterReset(&filter, sections, (float)g_sampleRate);
+			filter.run = runs[p];
+			QueryPerformanceCounter(&start);
+			for (int n = 0; n < iterations; n++) {
+				float detune = (n % 50) * 0.01f;
+				IfFilterProcess(&filter, samples, BUFFER_SIZE, detune);
+			}
+			double ns = GetElapsedSeconds(start) * 1e9 / totalFrames;
+			printf("  %s, order %d: %.2f ns/frame\n", names[p], sections * 2,
+				   ns);
+		}
+	}
+	if (paths == 1) {
+		printf("  SSE2: not supported on this CPU\n");
+	}
+}
+
+DWORD CALLBACK BenchmarkSourceProc(HSTREAM handle, void* buffer, DWORD length,
+								   void* user) {
+	// Endless quiet noise standing in for a decoded station
+	NoiseFillScalar((NoiseGenerator*)user, (float*)buffer,
+					length / sizeof(float), 0.1f);
+	return length;
+}
+
+void BenchmarkStationPath() {
+	static MixerState mixer;
+	static float block[ATMOSPHERE_BLOCK_SIZE * MIXER_CHANNELS];
+	const int iterations = 2000;
+	double totalFrames = (double)ATMOSPHERE_BLOCK_SIZE * iterations;
+	DWORD rates[3] = {g_sampleRate, 44100, 22050};
+	double nativeNs = 0.0;
+	NoiseGenerator gen;
+	LARGE_INTEGER start;
+
+	// The old path converted the static through int16 mono and had BASS
+	// resample every stream; now each station is resampled at most once,
+	// and not at all when it already matches the device
+	printf("Station path per stream (stereo float, output %lu Hz):\n",
+		   g_sampleRate);
+	for (int r = 0; r < 3; r++) {
+		if (r > 0 && rates[r] == g_sampleRate) continue;
+
+		NoiseSeed(&gen, 1);
+		HSTREAM source = BASS_StreamCreate(rates[r], MIXER_CHANNELS,
+			BASS_SAMPLE_FLOAT | BASS_STREAM_DECODE, BenchmarkSourceProc, &gen);
+		if (!source) {
+			printf("  %lu Hz: could not create source (BASS Error: %d)\n",
+				   rates[r], BASS_ErrorGetCode());
+			continue;
+		}
+
+		MixerAttach(&mixer, source, g_sampleRate);
+		QueryPerformanceCounter(&start);
+		for (int n = 0; n < iterations; n++) {
+			MixerReadStation(&mixer, block, ATMOSPHERE_BLOCK_SIZE);
+		}
+		double ns = GetElapsedSeconds(start) * 1e9 / totalFrames;
+		BASS_StreamFree(source);
+
+		if (r == 0) {
+			nativeNs = ns;
+			printf("  %lu Hz (native): %.2f ns/frame\n", rates[r], ns);
+		} else {
+			printf("  %lu Hz (resampled): %.2f ns/frame, native saves %.0f%%\n",
+				   rates[r], ns, ns > 0.0 ? (ns - nativeNs) * 100.0 / ns : 0.0);
+		}
+	}
+}
+
+// The playback path before the mixer, rebuilt for comparison: each
+// source its own int16 BASS output stream, BASS mixing and resampling
+#define PIPELINE_SECONDS 4
+#define PIPELINE_BASELINE_RATE 44100
+
+typedef struct {
+	NoiseGenerator gen;
+	float level;
+} PipelineShortSource;
+
+typedef struct {
+	MixerState mixer;
+	AtmosphereState atmosphere;
+} PipelineMixer;
+
+DWORD CALLBACK PipelineShortProc(HSTREAM handle, void* buffer, DWORD length,
+								 void* user) {
+	// Float noise converted to int16, as a decoded station or the old
+	// static generator handed it to BASS
+	PipelineShortSource* source = (PipelineShortSource*)user;
+	short* out = (short*)buffer;
+	DWORD count = length / sizeof(short);
+	float block[LFO_BLOCK_SIZE];
+
+	for (DWORD done = 0; done < count; done += LFO_BLOCK_SIZE) {
+		DWORD chunk = count - done;
+		if (chunk > LFO_BLOCK_SIZE) chunk = LFO_BLOCK_SIZE;
+		NoiseFillScalar(&source->gen, block, chunk, source->level);
+		for (DWORD i = 0; i < chunk; i++) {
+			out[done + i] = (short)(block[i] * 32767.0f);
+		}
+	}
+	return length;
+}
+
+DWORD CALLBACK PipelineMixerProc(HSTREAM handle, void* buffer, DWORD length,
+								 void* user) {
+	// MixerStreamProc's station and static work, without the extras the
+	// old path never had (IF filter, meters, timeshift)
+	PipelineMixer* pipe = (PipelineMixer*)user;
+	float* out = (float*)buffer;
+	DWORD frames = length / (MIXER_CHANNELS * sizeof(float));
+	float noise[ATMOSPHERE_BLOCK_SIZE];
+
+	for (DWORD done = 0; done < frames; ) {
+		DWORD chunk = frames - done;
+		if (chunk > ATMOSPHERE_BLOCK_SIZE) chunk = ATMOSPHERE_BLOCK_SIZE;
+
+		float* dest = out + done * MIXER_CHANNELS;
+		MixerReadStation(&pipe->mixer, dest, chunk);
+		AtmosphereRender(&pipe->atmosphere, noise, chunk, 16.35f);
+		for (DWORD i = 0; i < chunk; i++) {
+			dest[i * 2] += noise[i] * 0.3f;
+			dest[i * 2 + 1] += noise[i] * 0.3f;
+		}
+		done += chunk;
+	}
+	return length;
+}
+
+double PipelineMeasure(HSTREAM* streams, int count) {
+	// Process CPU per second of audio, muted, including BASS's own
+	// mixing and resampling threads; 0 if a stream would not play
+	double cpu = 0.0;
+	int playing = 0;
+
+	for (int i = 0; i < count; i++) {
+		BASS_ChannelSetAttribute(streams[i], BASS_ATTRIB_VOL, 0.0f);
+	}
+	for (playing = 0; playing < count; playing++) {
+		if (!BASS_ChannelPlay(streams[playing], FALSE)) break;
+	}
+	if (playing == count) {
+		double start = GetProcessCpuSeconds();
+		Sleep(PIPELINE_SECONDS * 1000);
+		cpu = (GetProcessCpuSeconds() - start) / PIPELINE_SECONDS;
+	}
+	for (int i = 0; i < count; i++) {
+		BASS_StreamFree(streams[i]);
+	}
+	return playing == count ? cpu : 0.0;
+}
+
+void BenchmarkPipeline() {
+	static PipelineShortSource station, hiss;
+	static PipelineMixer pipe;
+	NoiseGenerator gen;
+
+	printf("Playback pipeline (%d s each, muted, process CPU):\n",
+		   PIPELINE_SECONDS);
+	if (g_audio.outputStream) {
+		// The radio's own output would be counted in both runs
+		printf("  skipped: switch the radio off first\n");
+		return;
+	}
+
+	// Baseline: a 44.1 kHz stereo station and a mono static stream, each
+	// played on its own and mixed by BASS
+	HSTREAM old[2];
+	NoiseSeed(&station.gen, 1);
+	station.level = 0.1f;
+	NoiseSeed(&hiss.gen, 2);
+	hiss.level = 0.3f;
+	old[0] = BASS_StreamCreate(PIPELINE_BASELINE_RATE, 2, 0,
+							   PipelineShortProc, &station);
+	old[1] = BASS_StreamCreate(PIPELINE_BASELINE_RATE, 1, 0,
+							   PipelineShortProc, &hiss);
+	if (!old[0] || !old[1]) {
+		printf("  could not create baseline streams (BASS Error: %d)\n",
+			   BASS_ErrorGetCode());
+		if (old[0]) BASS_StreamFree(old[0]);
+		if (old[1]) BASS_StreamFree(old[1]);
+		return;
+	}
+	double baseline = PipelineMeasure(old, 2);
+
+	// Now: the same station as a decode channel pulled by one float
+	// stream that also renders the static
+	NoiseSeed(&gen, 1);
+	HSTREAM source = BASS_StreamCreate(PIPELINE_BASELINE_RATE, MIXER_CHANNELS,
+		BASS_SAMPLE_FLOAT | BASS_STREAM_DECODE, BenchmarkSourceProc, &gen);
+	if (!source) {
+		printf("  could not create source (BASS Error: %d)\n",
+			   BASS_ErrorGetCode());
+		return;
+	}
+	MixerAttach(&pipe.mixer, source, g_sampleRate);
+	AtmosphereReset(&pipe.atmosphere, 3, (float)g_sampleRate);
+	HSTREAM mixed = BASS_StreamCreate(g_sampleRate, MIXER_CHANNELS,
+		BASS_SAMPLE_FLOAT, PipelineMixerProc, &pipe);
+	double now = 0.0;
+	if (mixed) {
+		now = PipelineMeasure(&mixed, 1);
+	} else {
+		printf("  could not create mixer stream (BASS Error: %d)\n",
+			   BASS_ErrorGetCode());
+	}
+	BASS_StreamFree(source);
+
+	if (baseline <= 0.0 || now <= 0.0) {
+		printf("  no measurement (output device unavailable)\n");
+		return;
+	}
+	printf("  per-stream BASS_ChannelPlay: %.1f ms CPU per second\n",
+		   baseline * 1e3);
+	printf("  float mixer stream: %.1f ms CPU per second\n", now * 1e3);
+	printf("  CPU saved: %.0f%% (%.1f ms per second)\n",
+		   (baseline - now) * 100.0 / baseline, (baseline - now) * 1e3);
+}
+
+void BenchmarkTuner() {
+	// Scripted dial movement at 60 mouse events per second: a slow sweep
+	// across the whole band, a quick back-and-forth drag over FIP, then
+	// resting on it
+	const DWORD tick = 16;
+	const int sweepSteps = 750;    // 12 s, 10 - 34 MHz
+	const int wiggleSteps = 250;   // 4 s around 16.35 MHz
+	const int restSteps = 125;     // 2 s on 16.35 MHz
+	Tuner tuner = {};
+	RadioStation* oldCurrent = NULL;
+	DWORD oldConnects = 0, oldDisconnects = 0;
+	DWORD now = 0;
+
+	for (int step = 0; step < sweepSteps + wiggleSteps + restSteps; step++) {
+		float frequency;
+		if (step < sweepSteps) {
+			frequency = 10.0f + 24.0f * step / sweepSteps;
+		} else if (step < sweepSteps + wiggleSteps) {
+			frequency = 16.35f + 0.7f * (float)sin((step - sweepSteps) * 0.15);
+		} else {
+			frequency = 16.35f;
+		}
+
+		RadioStation* station = FindNearestStation(frequency);
+		int strength = 0;
+		if (station) {
+			float signal = GetStationSignalStrength(station, frequency);
+			strength = (int)(signal * 100.0f);
+		}
+
+		// Previous rule: connect the moment strength passes 50, drop the
+		// moment the dial leaves every station's range
+		if (station) {
+			if (strength > 50 && station != oldCurrent) {
+				if (oldCurrent) oldDisconnects++;
+				oldConnects++;
+				oldCurrent = station;
+			}
+		} else if (oldCurrent) {
+			oldDisconnects++;
+			oldCurrent = NULL;
+		}
+
+		TunerStep(&tuner, station, strength, now);
+		now += tick;
+	}
+
+	printf("Tuner (scripted %d-event sweep):\n",
+		   sweepSteps + wiggleSteps + restSteps);
+	printf("  immediate retune: %lu connects, %lu disconnects\n",
+		   oldConnects, oldDisconnects);
+	printf("  state machine: %lu connects, %lu disconnects "
+		   "(dwell %d ms, grace %d ms)\n", tuner.connects, tuner.disconnects,
+		   TUNER_DWELL_MS, TUNER_GRACE_MS);
+}
+
+void BenchmarkIcyParser() {
+	static const char* samples[] = {
+		"StreamTitle='Boards of Canada - Roygbiv';StreamUrl='';",
+		"StreamTitle='It's a Beautiful Day';",
+		"StreamTitle='';",
+		"StreamTitle='Truncated block",
+		"StreamTitle='Dangling quote'",
+		"StreamTitle=",
+		"StreamUrl='http://example.com';",
+		"",
+		"StreamTitle='Tab\there\r\nand newline';",
+		"StreamTitle=';';StreamTitle='second';",
+	};
+	const int sampleCount = sizeof(samples) / sizeof(samples[0]);
+	const int fuzzRounds = 20000;
+	static char block[4096 + 32];
+	char title[ICY_TITLE_SIZE + 1];
+	NoiseGenerator gen;
+	int bad = 0;
+
+	// Hand-written edge cases, then random blocks around the StreamTitle
+	// key with lengths past the title buffer; the title must always end
+	// inside its buffer and the guard byte after it must stay untouched
+	NoiseSeed(&gen, 1);
+	memset(title, 0, sizeof(title));
+	title[ICY_TITLE_SIZE] = 0x5A;
+	for (int n = 0; n < sampleCount + fuzzRounds; n++) {
+		const char* meta = samples[n % sampleCount];
+		if (n >= sampleCount) {
+			int length = 13 + (int)(NoiseRandomUnit(&gen) * 4096);
+			strcpy(block, "StreamTitle='");
+			for (int i = 13; i < length; i++) {
+				float r = NoiseRandomUnit(&gen);
+				block[i] = r < 0.02f ? '\'' : r < 0.04f ? ';'
+						 : (char)(1 + (int)(r * 254));
+			}
+			block[length] = '\0';
+			meta = block;
+		}
 
-	// Get levels from current stream if playing
-	if (g_audio.currentStream && BASS_ChannelIsActive(g_audio.currentStream) == BASS_ACTIVE_PLAYING) {
-		DWORD level = BASS_ChannelGetLevel(g_audio.currentStream);
-		if (level != -1) {
-			// Extract left and right channel levels and apply volume scaling
-			float rawLeft = (float)LOWORD(level) / 32768.0f;
-			float rawRight = (float)HIWORD(level) / 32768.0f;
+		IcyParseTitle(meta, title, ICY_TITLE_SIZE);
+		if (strlen(title) >= ICY_TITLE_SIZE || title[ICY_TITLE_SIZE] != 0x5A) {
+			bad++;
+		}
+	}
+
+	const int iterations = 200000;
+	LARGE_INTEGER start;
+	QueryPerformanceCounter(&start);
+	for (int n = 0; n < iterations; n++) {
+		IcyParseTitle(samples[n & 1], title, ICY_TITLE_SIZE);
+	}
+	double ns = GetElapsedSeconds(start) * 1e9 / iterations;
+
+	printf("ICY metadata parser:\n");
+	printf("  %d malformed and random blocks: %s\n", sampleCount + fuzzRounds,
+		   bad ? "OUT OF BOUNDS" : "all bounded");
+	printf("  %.0f ns per parse\n", ns);
+}
+
+void BenchmarkTimeshift() {
+	static Timeshift ts;
+	static float chunk[MIXER_PULL_FRAMES * MIXER_CHANNELS];
+	DWORD rate = g_sampleRate ? g_sampleRate : SAMPLE_RATE;
+	const DWORD simulated = 600;
+
+	// A private one-minute ring with no writer thread; the drain is run
+	// inline after each chunk so the two sides can be timed apart
+	if (!TimeshiftOpen(&ts, 60, rate)) {
+		printf("Timeshift: no temp file, skipped\n");
+		return;
+	}
 
-			// Apply the same volume scaling as the actual audio output
-			float streamVolume = g_radio.volume * (g_radio.signalStrength / 100.0f);
-			g_audio.vuLevelLeft = rawLeft * streamVolume;
-			g_audio.vuLevelRight = rawRight * streamVolume;
+	double captureSeconds = 0.0;
+	double drainSeconds = 0.0;
+	ULONGLONG total = (ULONGLONG)simulated * rate;
+	LARGE_INTEGER start;
+	while (ts.capturedFrames < total) {
+		// A ramp keyed to the capture position, checked on replay below
+		for (DWORD i = 0; i < MIXER_PULL_FRAMES; i++) {
+			float value = (float)((ts.capturedFrames + i) % 20000) / 32768.0f;
+			chunk[i * 2] = value;
+			chunk[i * 2 + 1] = -value;
 		}
+
+		QueryPerformanceCounter(&start);
+		TimeshiftCapture(&ts, chunk, MIXER_PULL_FRAMES);
+		captureSeconds += GetElapsedSeconds(start);
+
+		QueryPerformanceCounter(&start);
+		TimeshiftDrain(&ts);
+		drainSeconds += GetElapsedSeconds(start);
+	}
+
+	// Rewind ten seconds and make sure the ring hands the ramp back
+	ts.shifted = 1;
+	ts.playFrame = ts.capturedFrames -
+				   (ULONGLONG)TIMESHIFT_REWIND_SECONDS * rate;
+	ULONGLONG first = ts.playFrame;
+	TimeshiftWant(&ts, ts.playFrame);
+	TimeshiftLoadReplay(&ts);
+	TimeshiftReplay(&ts, chunk, MIXER_PULL_FRAMES);
+	int bad = 0;
+	for (DWORD i = 0; i < MIXER_PULL_FRAMES; i++) {
+		float ramp = (float)((first + i) % 20000) / 32768.0f;
+		short expected = (short)(ramp * 32767.0f);
+		if ((short)(chunk[i * 2] * 32768.0f) != expected) bad++;
 	}
+	TimeshiftClose(&ts);
+
+	double scale = 3600.0 / simulated;
+	double megabytes = 3600.0 * rate * MIXER_CHANNELS * sizeof(short) /
+					   (1024.0 * 1024.0);
+	printf("Timeshift ring (%lu Hz, %.0f MB per hour of audio):\n", rate,
+		   megabytes);
+	printf("  capture on the mixer thread: %.1f ms per hour of audio\n",
+		   captureSeconds * scale * 1000.0);
+	printf("  sequential writes to the mapping: %.1f ms per hour of audio\n",
+		   drainSeconds * scale * 1000.0);
+	printf("  rewind %d s: %s, %lu blocks dropped, "
+		   "%lu runs read from the mapping\n", TIMESHIFT_REWIND_SECONDS,
+		   bad ? "MISMATCH" : "ok", ts.dropped, ts.replayMisses);
+}
 
-	// Add static contribution if static is playing
-	if (g_audio.staticStream && BASS_ChannelIsActive(g_audio.staticStream) == BASS_ACTIVE_PLAYING) {
-		DWORD staticLevel = BASS_ChannelGetLevel(g_audio.staticStream);
-		if (staticLevel != -1) {
-			float staticLeft = (float)LOWORD(staticLevel) / 32768.0f;
-			float staticRight = (float)HIWORD(staticLevel) / 32768.0f;
+int CompareFloats(const void* a, const void* b) {
+	float fa = *(const float*)a;
+	float fb = *(const float*)b;
+	return fa < fb ? -1 : fa > fb ? 1 : 0;
+}
 
-			// Apply static volume scaling
-			float staticVolume = (100.0f - g_radio.signalStrength) / 100.0f;
-			float scaledStaticVolume = g_radio.volume * staticVolume * g_audio.staticVolume;
+void BenchmarkStationDirectory() {
+	static float keys[100000];
+	static int buckets[100000 + 1];
+	static int oneBucket[2];
+	static float queries[4096];
+	static const int sizes[] = {12, 100, 1000, 10000, 100000};
+	const int queryCount = sizeof(queries) / sizeof(queries[0]);
+	NoiseGenerator gen;
+	volatile int sink = 0;
+
+	NoiseSeed(&gen, 7);
+	for (int q = 0; q < queryCount; q++) {
+		queries[q] = 9.0f + NoiseRandomUnit(&gen) * 26.0f;
+	}
 
-			// Ensure minimum static when radio is on but no strong signal
-			if (g_radio.power && g_radio.signalStrength < 50.0f) {
-				scaledStaticVolume = fmax(scaledStaticVolume, g_radio.volume * 0.1f);
+	// Random directories over the dial; the old linear scan against a
+	// plain binary search (one bucket) and the bucketed index
+	printf("Station directory, nearest station lookup:\n");
+	printf("  %8s %12s %12s %12s\n", "stations", "linear ns", "binary ns",
+		   "bucketed ns");
+	for (int s = 0; s < (int)(sizeof(sizes) / sizeof(sizes[0])); s++) {
+		int count = sizes[s];
+		for (int i = 0; i < count; i++) {
+			keys[i] = 10.0f + NoiseRandomUnit(&gen) * 24.0f;
+		}
+		qsort(keys, count, sizeof(float), CompareFloats);
+
+		StationIndex binary, bucketed;
+		BuildStationIndex(&binary, keys, count, oneBucket, 1);
+		BuildStationIndex(&bucketed, keys, count, buckets, count);
+
+		int mismatches = 0;
+		LARGE_INTEGER start;
+		int linearQueries = count > 10000 ? 256 : queryCount;
+		QueryPerformanceCounter(&start);
+		for (int q = 0; q < linearQueries; q++) {
+			int nearest = 0;
+			float minDistance = 999.0f;
+			for (int i = 0; i < count; i++) {
+				float distance = fabs(keys[i] - queries[q]);
+				if (distance < minDistance) {
+					minDistance = distance;
+					nearest = i;
+				}
+			}
+			sink += nearest;
+			int indexed = StationIndexNearest(&bucketed, queries[q]);
+			if (fabs(keys[indexed] - queries[q]) != minDistance) mismatches++;
+		}
+		double linearNs = GetElapsedSeconds(start) * 1e9 / linearQueries;
+
+		const int rounds = 64;
+		int lookups = rounds * queryCount;
+		QueryPerformanceCounter(&start);
+		for (int r = 0; r < rounds; r++) {
+			for (int q = 0; q < queryCount; q++) {
+				sink += StationIndexNearest(&binary, queries[q]);
 			}
+		}
+		double binaryNs = GetElapsedSeconds(start) * 1e9 / lookups;
 
-			// Combine with existing levels (simulate mixing)
-			g_audio.vuLevelLeft = fmin(1.0f, g_audio.vuLevelLeft + staticLeft * scaledStaticVolume * 0.3f);
-			g_audio.vuLevelRight = fmin(1.0f, g_audio.vuLevelRight + staticRight * scaledStaticVolume * 0.3f);
+		QueryPerformanceCounter(&start);
+		for (int r = 0; r < rounds; r++) {
+			for (int q = 0; q < queryCount; q++) {
+				sink += StationIndexNearest(&bucketed, queries[q]);
+			}
 		}
+		double bucketedNs = GetElapsedSeconds(start) * 1e9 / lookups;
+
+		printf("  %8d %12.1f %12.1f %12.1f%s\n", count, linearNs, binaryNs,
+			   bucketedNs, mismatches ? "  MISMATCH" : "");
+	}
+}
+
+int LogBenchmarkWrite(LogRing* ring, const char* format, ...) {
+	va_list args;
+	va_start(args, format);
+	int written = LogWrite(ring, format, args);
+	va_end(args);
+	return written;
+}
+
+void BenchmarkLogging() {
+	static LogRing ring;
+	static char buffer[1024];
+	const int iterations = LOG_RING_SIZE - 1;
+	const char* name = g_stations[0].name;
+	LARGE_INTEGER start;
+
+	// The hot path: a typical line with numbers and a string, into a
+	// private ring with no drain running so nothing is dropped
+	LogRingInit(&ring);
+	QueryPerformanceCounter(&start);
+	for (int i = 0; i < iterations; i++) {
+		LogBenchmarkWrite(&ring,
+			"Buffering %s: net buffer %lu ms, prebuffer %lu%%, %.2f\n",
+			name, (DWORD)i, (DWORD)75, i * 0.5f);
+	}
+	double logNs = GetElapsedSeconds(start) * 1e9 / iterations;
+
+	// What the drain pays later to format those records
+	QueryPerformanceCounter(&start);
+	int drained = LogDrainRing(&ring, buffer, sizeof(buffer), NULL);
+	double drainNs = GetElapsedSeconds(start) * 1e9 / (drained ? drained : 1);
+
+	// A full ring drops instead of waiting
+	for (int i = 0; i < LOG_RING_SIZE; i++) {
+		LogBenchmarkWrite(&ring, "fill %d\n", i);
+	}
+	QueryPerformanceCounter(&start);
+	for (int i = 0; i < iterations; i++) {
+		LogBenchmarkWrite(&ring, "fill %d\n", i);
+	}
+	double droppedNs = GetElapsedSeconds(start) * 1e9 / iterations;
+
+	// For scale: only the formatting half of a synchronous printf
+	QueryPerformanceCounter(&start);
+	for (int i = 0; i < iterations; i++) {
+		snprintf(buffer, sizeof(buffer),
+			"Buffering %s: net buffer %lu ms, prebuffer %lu%%, %.2f\n",
+			name, (DWORD)i, (DWORD)75, i * 0.5f);
 	}
+	double formatNs = GetElapsedSeconds(start) * 1e9 / iterations;
+
+	printf("Logging (%d-record ring, %d bytes each):\n", LOG_RING_SIZE,
+		   (int)sizeof(LogRecord));
+	printf("  Log call: %.0f ns\n", logNs);
+	printf("  Log call with the ring full: %.0f ns (%ld dropped)\n",
+		   droppedNs, ring.dropped);
+	printf("  drain formatting: %.0f ns per record, %d records\n",
+		   drainNs, drained);
+	printf("  snprintf of the same line: %.0f ns, before any console I/O\n",
+		   formatNs);
+}
+
+void BenchmarkTrace() {
+	static Trace trace;
+	const int iterations = 1000000;
+	RadioStation* station = &g_stations[0];
+	LARGE_INTEGER start;
+
+	// What every instrumented call pays while tracing is off
+	trace.enabled = 0;
+	QueryPerformanceCounter(&start);
+	for (int i = 0; i < iterations; i++) {
+		LONGLONG span = TraceBegin(&trace);
+		TraceEnd(&trace, "benchmark", station, span);
+	}
+	double offNs = GetElapsedSeconds(start) * 1e9 / iterations;
+
+	// On: two clock reads and a claim, into a private ring
+	trace.enabled = 1;
+	QueryPerformanceCounter(&start);
+	for (int i = 0; i < iterations; i++) {
+		LONGLONG span = TraceBegin(&trace);
+		TraceEnd(&trace, "benchmark", station, span);
+	}
+	double onNs = GetElapsedSeconds(start) * 1e9 / iterations;
 
-	// Apply some smoothing/decay for more realistic VU behavior
-	static float lastLeft = 0.0f, lastRight = 0.0f;
-	g_audio.vuLevelLeft = g_audio.vuLevelLeft * 0.7f + lastLeft * 0.3f;
-	g_audio.vuLevelRight = g_audio.vuLevelRight * 0.7f + lastRight * 0.3f;
-	lastLeft = g_audio.vuLevelLeft;
-	lastRight = g_audio.vuLevelRight;
+	printf("Tune trace (%d-event ring, %d bytes each):\n", TRACE_EVENTS,
+		   (int)sizeof(TraceEvent));
+	printf("  span while off: %.1f ns\n", offNs);
+	printf("  span while on: %.1f ns\n", onNs);
+}
+
+void BenchmarkFrame() {
+	const int frames = 300;
+	RECT rect = {0, 0, GDI_FRAME_WIDTH, GDI_FRAME_HEIGHT};
+	LARGE_INTEGER start;
+
+	// A window-sized back buffer, as WM_PAINT uses
+	HDC screenDC = GetDC(NULL);
+	HDC frameDC = CreateCompatibleDC(screenDC);
+	HBITMAP frame = CreateCompatibleBitmap(screenDC, rect.right, rect.bottom);
+	ReleaseDC(NULL, screenDC);
+	HBITMAP oldFrame = (HBITMAP)SelectObject(frameDC, frame);
+	HANDLE process = GetCurrentProcess();
+
+	// Before: a fresh pen, brush or font for every use, freed per frame
+	DWORD handlesBefore = GetGuiResources(process, GR_GDIOBJECTS);
+	g_gdi.uncached = 1;
+	QueryPerformanceCounter(&start);
+	for (int i = 0; i < frames; i++) {
+		DrawRadioInterface(frameDC, &rect);
+		GdiReleaseTransient(frameDC);
+	}
+	GdiFlush();
+	double uncachedUs = GetElapsedSeconds(start) * 1e6 / frames;
+	g_gdi.uncached = 0;
+	DWORD handlesUncached = GetGuiResources(process, GR_GDIOBJECTS);
+
+	// After: painting only selects cached objects
+	QueryPerformanceCounter(&start);
+	for (int i = 0; i < frames; i++) {
+		DrawRadioInterface(frameDC, &rect);
+	}
+	GdiFlush();
+	double cachedUs = GetElapsedSeconds(start) * 1e6 / frames;
+	DWORD handlesCached = GetGuiResources(process, GR_GDIOBJECTS);
+
+	printf("Frame (%dx%d, DrawRadioInterface):\n", GDI_FRAME_WIDTH,
+		   GDI_FRAME_HEIGHT);
+	printf("  creating GDI objects per frame: %.1f us\n", uncachedUs);
+	printf("  cached GDI objects: %.1f us (%.1fx)\n", cachedUs,
+		   uncachedUs / (cachedUs > 0.0 ? cachedUs : 1.0));
+	printf("  GDI handles: %lu before, %lu after %d uncached frames, "
+		   "%lu after %d cached\n",
+		   handlesBefore, handlesUncached, frames, handlesCached, frames);
+	printf("  cache: %d pens and brushes, %d fonts, %d created after startup\n",
+		   g_gdi.count, g_gdi.fontCount, g_gdi.misses);
+
+	SelectObject(frameDC, oldFrame);
+	DeleteObject(frame);
+	DeleteDC(frameDC);
 }